@@ -16,6 +16,17 @@
 #include <TH2F.h>
 #include <TLegend.h>
 #include <TGraph.h>
+#include <TMD5.h>
+#include <ROOT/TThreadExecutor.hxx>
+#include <functional>
+#include <mutex>
+#include <fstream>
+#include <numeric>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 //---------------------------------------
 //  typedef, const, global
 //---------------------------------------
@@ -120,6 +131,19 @@ class BSHistHelper {
   // TODO
 };
 
+//____________________________________
+// One projection of BSTHnSparseHelper::GetProjections, with the arguments of GetTH1/GetTH2
+struct BSProjSpec {
+  BSProjSpec( TString _name, Int_t _xDim, Int1D _bin ):name(_name),xDim(_xDim){ for( auto b : _bin ) bin.push_back({b,b}); }
+  BSProjSpec( TString _name, Int_t _xDim, Int2D _bin ):name(_name),xDim(_xDim),bin(_bin){}
+  BSProjSpec( TString _name, Int_t _xDim, Int_t _yDim, Int1D _bin ):BSProjSpec(_name,_xDim,_bin){ yDim=_yDim; }
+  BSProjSpec( TString _name, Int_t _xDim, Int_t _yDim, Int2D _bin ):name(_name),xDim(_xDim),yDim(_yDim),bin(_bin){}
+  TString name;
+  Int_t   xDim;
+  Int_t   yDim=-1; // -1 : TH1
+  Int2D   bin;
+};
+
 class BSTHnSparseHelper {
 public:
   BSTHnSparseHelper(THnSparse*h):fH(h){LoadBinFromHist();}
@@ -146,6 +170,7 @@ public:
   TH1D * GetTH1( TString name, Int1D bin, Option_t*opt=""){ return GetTH1( name, GetNdim()-1, bin, opt ); }
   TH2D * GetTH2( TString name, Int_t xDim,Int_t yDim, Int1D bin, Option_t*opt="");
   TH2D * GetTH2( TString name, Int_t xDim,Int_t yDim, Int2D bin, Option_t*opt="");
+  vector<TH1*> GetProjections( vector<BSProjSpec> specs, Option_t*opt="");
 
   BSRanger BinRange( int i ){ return bin_range( GetBin(i) ); }
   BSRanger BinRange( TString n ){ return bin_range( GetBin(n) ); }
@@ -156,14 +181,37 @@ public:
   void SetBin( Double2D bins );
   void SetBin( int i, Double1D bins );
   void SetBin( TString name, Double1D bins ){ SetBin( GetAxisID(name), bins); }
+  const Int1D& GetCellMap( int i ){ return fCellMap[i]; }
+  BSTHnSparseHelper GetRebinned( TString name="-" );
+  void ExportColumns( TString fileName );
   static BSTHnSparseHelper Load( TString name, TObject * clist=nullptr );
   static BSTHnSparseHelper Load( TString name, TString fname, TString lname="" );
+
+  //================
+  //  CACHE
+  //================
+  // Projections are kept in <dir>/<source>.<md5 of source>.root ( "" : no cache )
+  static TString & CacheDir(){ static TString dir; return dir; }
+  static void SetCacheDir( TString dir ){ CacheDir() = dir; }
+  void SetSource( TString fileName, TString objectPath="" ){ fSourceFile=fileName; fObjectPath=objectPath; }
+  static std::mutex & CacheMutex(){ static std::mutex m; return m; } // cache files are shared by helpers of one source
 private:
+  Int2D GetAxisCuts();
+  TString CacheKey( Int1D dims, Int2D cuts, Option_t *opt );
+  TString SourceChecksum();
+  TFile * OpenCache();
+  TH1 * ReadCache( TFile *f, TString key, TString name, TString title, TDirectory *dir );
+  Int2D GetCellRange( TString &name, TString &title, Int1D dims, Int2D bin );
+  TH1 * NewProjection( TString name, TString title, Int_t xDim, Int_t yDim );
   void LoadBinFromHist();
   void LoadBinFromHist( int iaxis );
+  void BuildCellMap( int iaxis );
   THnSparse * fH;
   Double2D    fCBins;
   Double2D    fCBinsB;
+  Int2D       fCellMap; // cell of fH axis -> cell of the SetBin binning ( 0, overflow included )
+  TString     fSourceFile;
+  TString     fObjectPath;
 };
 
 //__________________________________________________________
@@ -218,35 +266,18 @@ TH1D * BSTHnSparseHelper::GetTH1( TString name, Int_t xDim, vector<int> bin, Opt
 }
 //__________________________________________________________
 TH1D * BSTHnSparseHelper::GetTH1( TString name, Int_t xDim, Int2D bin, Option_t*opt){
-  //== Histogram Name and Title
-  if( name.EndsWith("-") ) name+=Form("%sP%02d",fH->GetName(),xDim);
-  TString title = fH->GetTitle();
-  for( UInt_t i=0;i<bin.size();i++ ){
-    Int1D b = bin[i];
-    Int1D nb = { 0, 0 };
-    int maxnbin = fCBinsB[i].size()-2;
-    auto ax = GetAxis(i);
-    if( b[0]<-1 || b[1]<-1 || b[0] > maxnbin || b[1] > maxnbin || b[0] > b[1] ) ErrorExit(Form("Wrong bin : %i : %s : %d %d",i,ax->GetName(),b[0],b[1])); 
-    if( int(i) == xDim || b.size()==0 || ( b[0]<=0 && b[1]<=0 ) ){
-    }else{
-      if( b[0] > 0 ) nb[0] = fCBinsB[i][b[0]];
-      if( b[1] > 0 ) nb[1] = fCBinsB[i][b[1]+1]-1;
-      //if( b0 > b1 ) b1 = b1;
-      name+=Form("%s%03d%03d",GetAxis(i)->GetName(), b[0],b[1]);
-      TString label[2];
-      label[0] = ax->GetBinLabel(nb[0]);
-      label[1] = ax->GetBinLabel(nb[1]);
-      if( label[0]=="" ) label[0] = Form("%.6f",ax->GetBinLowEdge( nb[0] )); else label[0] = Form("%d",nb[0]);// TODO Temp
-      if( label[1]=="" ) label[1] = Form("%.6f",ax->GetBinUpEdge( nb[1] )); else label[1] = Form("%d",nb[1]); // TODO Temp
-      TPMERegexp("\\.?0+$").Substitute(label[0],"");
-      TPMERegexp("\\.?0+$").Substitute(label[1],"");
-      title+=Form(" %s:%s", ax->GetName(), label[0].Data());
-      if( label[0]!=label[1] ) title+=Form("-%s",label[1].Data());
-    }
-    fH->GetAxis(i)->SetRange(nb[0], nb[1]);
-  }
+  TString title;
+  auto nb = GetCellRange( name, title, {xDim}, bin );
+  for( UInt_t i=0;i<nb.size();i++ )
+    fH->GetAxis(i)->SetRange(nb[i][0], nb[i][1]);
+  auto dir = gDirectory;
+  auto key = CacheKey( {xDim}, GetAxisCuts(), opt );
+  std::lock_guard<std::mutex> lock( CacheMutex() );
+  auto cache = OpenCache();
+  if( auto h = dynamic_cast<TH1D*>( ReadCache( cache, key, name, title, dir ) ) ){ delete cache; return h; }
   auto h = fH->Projection( xDim, opt );
   h->SetNameTitle(name,title);
+  if( cache ){ cache->WriteTObject( h, key, "Overwrite" ); delete cache; dir->cd(); }
   return h;
 }
 //__________________________________________________________
@@ -256,16 +287,33 @@ TH2D * BSTHnSparseHelper::GetTH2( TString name, Int_t xDim, Int_t yDim, vector<i
   return GetTH2( name, xDim,yDim, newbin, opt );
 }
 TH2D * BSTHnSparseHelper::GetTH2( TString name, Int_t xDim,Int_t yDim, Int2D bin, Option_t*opt){
-  //== Histogram Name and Title
-  if( name.EndsWith("-") ) name+=Form("%sP%02d",fH->GetName(),xDim);
-  TString title = fH->GetTitle();
+  TString title;
+  auto nb = GetCellRange( name, title, {xDim,yDim}, bin );
+  for( UInt_t i=0;i<nb.size();i++ )
+    fH->GetAxis(i)->SetRange(nb[i][0], nb[i][1]);
+  auto dir = gDirectory;
+  auto key = CacheKey( {xDim,yDim}, GetAxisCuts(), opt );
+  std::lock_guard<std::mutex> lock( CacheMutex() );
+  auto cache = OpenCache();
+  if( auto h = dynamic_cast<TH2D*>( ReadCache( cache, key, name, title, dir ) ) ){ delete cache; return h; }
+  auto h = fH->Projection( yDim,xDim, opt );
+  h->SetNameTitle(name,title);
+  if( cache ){ cache->WriteTObject( h, key, "Overwrite" ); delete cache; dir->cd(); }
+  return h;
+}
+//__________________________________________________________
+// Histogram name and title, and the cell range ( SetRange arguments ) of each axis in bin
+Int2D BSTHnSparseHelper::GetCellRange( TString &name, TString &title, Int1D dims, Int2D bin ){
+  if( name.EndsWith("-") ) name+=Form("%sP%02d",fH->GetName(),dims[0]);
+  title = fH->GetTitle();
+  Int2D cells;
   for( UInt_t i=0;i<bin.size();i++ ){
     Int1D b = bin[i];
     Int1D nb = { 0, 0 };
     int maxnbin = fCBinsB[i].size()-2;
     auto ax = GetAxis(i);
     if( b[0]<-1 || b[1]<-1 || b[0] > maxnbin || b[1] > maxnbin || b[0] > b[1] ) ErrorExit(Form("Wrong bin : %i : %s : %d %d",i,ax->GetName(),b[0],b[1])); 
-    if( int(i) == xDim || int(i) == yDim || b.size()==0 || ( b[0]<=0 && b[1]<=0 ) ){
+    if( std::find(dims.begin(),dims.end(),int(i)) != dims.end() || b.size()==0 || ( b[0]<=0 && b[1]<=0 ) ){
     }else{
       if( b[0] > 0 ) nb[0] = fCBinsB[i][b[0]];
       if( b[1] > 0 ) nb[1] = fCBinsB[i][b[1]+1]-1;
@@ -281,14 +329,204 @@ TH2D * BSTHnSparseHelper::GetTH2( TString name, Int_t xDim,Int_t yDim, Int2D bin
       title+=Form(" %s:%s", ax->GetName(), label[0].Data());
       if( label[0]!=label[1] ) title+=Form("-%s",label[1].Data());
     }
-    fH->GetAxis(i)->SetRange(nb[0], nb[1]);
+    cells.push_back(nb);
+  }
+  return cells;
+}
+//__________________________________________________________
+// Empty TH1D/TH2D with the binning, labels and titles of axis xDim ( and yDim )
+TH1 * BSTHnSparseHelper::NewProjection( TString name, TString title, Int_t xDim, Int_t yDim ){
+  TAxis * axes[2] = { GetAxis(xDim), yDim<0?nullptr:GetAxis(yDim) };
+  Double1D edges[2];
+  for( int j=0;j<2&&axes[j];j++ )
+    for( int ib=1;ib<=axes[j]->GetNbins()+1;ib++ ) edges[j].push_back( axes[j]->GetBinLowEdge(ib) );
+  TH1 * h;
+  if( yDim<0 ) h = new TH1D( name, title, edges[0].size()-1, edges[0].data() );
+  else         h = new TH2D( name, title, edges[0].size()-1, edges[0].data(), edges[1].size()-1, edges[1].data() );
+  TAxis * haxes[2] = { h->GetXaxis(), h->GetYaxis() };
+  for( int j=0;j<2&&axes[j];j++ ){
+    haxes[j]->SetName( axes[j]->GetName() );
+    haxes[j]->SetTitle( axes[j]->GetTitle() );
+    for( int ib=1;ib<=axes[j]->GetNbins();ib++ ){
+      const char * label = axes[j]->GetBinLabel(ib);
+      if( !TString(label).IsNull() ) haxes[j]->SetBinLabel( ib, label );
+    }
   }
-  auto h = fH->Projection( yDim,xDim, opt );
-  h->SetNameTitle(name,title);
   return h;
 }
+//__________________________________________________________
+// All projections of specs in a single sweep over the filled bins, instead of one
+// Projection ( a full scan ) per histogram. Axis cuts are those of GetTH1/GetTH2
+// with the same arguments, and axes beyond spec.bin keep their current range.
+// Unlike GetTH1/GetTH2, the axis ranges of fH are left untouched and the projected
+// axes are always taken in full. As Projection, errors are kept when fH has Sumw2
+// and computed from the contents with opt "E" otherwise
+vector<TH1*> BSTHnSparseHelper::GetProjections( vector<BSProjSpec> specs, Option_t*opt){
+  TString opts = opt; opts.ToUpper();
+  bool haveErrors = fH->GetCalculateErrors();
+  bool wantErrors = haveErrors || opts.Contains("E");
+  if( wantErrors && !opts.Contains("E") ) opts += "E"; // cache key of the histogram with errors
+  int ndim = GetNdim();
 
+  struct Cut { int axis, first, last; };
+  struct Proj { TH1 * h; int xDim, yDim, nx; vector<Cut> cuts; Double1D sumw, sumw2; double sum=0; UInt_t index; TString key; };
+  vector<Proj> projs;
+  vector<TH1*> hists( specs.size(), nullptr );
+  auto dir = gDirectory;
+  std::unique_lock<std::mutex> lock( CacheMutex() );
+  auto cache = OpenCache();
+  for( UInt_t k=0;k<specs.size();k++ ){
+    auto &spec = specs[k];
+    TString name = spec.name, title;
+    Int1D dims = {spec.xDim};
+    if( spec.yDim >= 0 ) dims.push_back(spec.yDim);
+    auto nb = GetCellRange( name, title, dims, spec.bin );
+    Proj p;
+    p.xDim = spec.xDim; p.yDim = spec.yDim;
+    for( int i=0;i<ndim;i++ ){
+      if( std::find(dims.begin(),dims.end(),i) != dims.end() ) continue;
+      int ncells = GetNbins(i)+1;
+      if( i < int(nb.size()) ){
+        // as TAxis::SetRange( nb[i][0], nb[i][1] )
+        int first = nb[i][0], last = nb[i][1];
+        if( last < first || (first < 0 && last < 0) || (first < 0 && last > ncells) || (first > ncells && last > ncells) || (first == 0 && last == 0) ) continue;
+        p.cuts.push_back({ i, std::max(first,0), std::min(last,ncells) });
+      }else if( GetAxis(i)->TestBit(TAxis::kAxisRange) )
+        p.cuts.push_back({ i, GetAxis(i)->GetFirst(), GetAxis(i)->GetLast() });
+    }
+    Int2D cuts;
+    for( auto &c : p.cuts ) cuts.push_back({ c.axis, c.first, c.last });
+    p.key = CacheKey( dims, cuts, opts );
+    p.index = k;
+    if( ( hists[k] = ReadCache( cache, p.key, name, title, dir ) ) ) continue;
+    p.h = NewProjection( name, title, spec.xDim, spec.yDim );
+    p.nx = GetNbins(spec.xDim)+2;
+    p.sumw.assign( p.nx*( spec.yDim<0 ? 1 : GetNbins(spec.yDim)+2 ), 0 );
+    if( wantErrors ) p.sumw2.assign( p.sumw.size(), 0 );
+    projs.push_back(p);
+  }
+  // the cache is released during the sweep
+  bool useCache = cache;
+  delete cache;
+  dir->cd();
+  lock.unlock();
+
+  double sumAll = 0;
+  vector<Int_t> coord(ndim);
+  for( Long64_t ibin=0;ibin<fH->GetNbins()&&!projs.empty();ibin++ ){
+    double v = fH->GetBinContent( ibin, coord.data() );
+    double e2 = 0;
+    if( wantErrors ) e2 = haveErrors ? fH->GetBinError2( ibin ) : v;
+    sumAll += v;
+    for( auto &p : projs ){
+      bool pass = true;
+      for( auto &c : p.cuts )
+        if( coord[c.axis] < c.first || coord[c.axis] > c.last ){ pass = false; break; }
+      if( !pass ) continue;
+      int gbin = coord[p.xDim] + ( p.yDim<0 ? 0 : p.nx*coord[p.yDim] );
+      p.sumw[gbin] += v;
+      if( wantErrors ) p.sumw2[gbin] += e2;
+      p.sum += v;
+    }
+  }
 
+  lock.lock();
+  cache = useCache && !projs.empty() ? OpenCache() : nullptr;
+  for( auto &p : projs ){
+    if( wantErrors ) p.h->Sumw2();
+    for( UInt_t gbin=0;gbin<p.sumw.size();gbin++ ){
+      if( p.sumw[gbin] == 0 && ( !wantErrors || p.sumw2[gbin] == 0 ) ) continue;
+      p.h->SetBinContent( gbin, p.sumw[gbin] );
+      if( wantErrors ) p.h->SetBinError( gbin, TMath::Sqrt(p.sumw2[gbin]) );
+    }
+    // entries scaled to the selected content, as Projection does for ranged axes
+    double entries = fH->GetEntries();
+    if( !p.cuts.empty() && sumAll != 0 ) entries *= p.sum/sumAll;
+    p.h->SetEntries( entries );
+    hists[p.index] = p.h;
+    if( cache ) cache->WriteTObject( p.h, p.key, "Overwrite" );
+  }
+  delete cache;
+  dir->cd();
+  return hists;
+}
+
+//__________________________________________________________
+// Ranges of all axes as set by SetRange ( axis, first, last )
+Int2D BSTHnSparseHelper::GetAxisCuts(){
+  Int2D cuts;
+  for( int i=0;i<GetNdim();i++ )
+    if( GetAxis(i)->TestBit(TAxis::kAxisRange) ) cuts.push_back({ i, GetAxis(i)->GetFirst(), GetAxis(i)->GetLast() });
+  return cuts;
+}
+//__________________________________________________________
+// Key of a projection in the cache file : object, projected axes, axis cuts and option
+TString BSTHnSparseHelper::CacheKey( Int1D dims, Int2D cuts, Option_t *opt ){
+  TString desc = Form("%s/%s;%s;%d", fObjectPath.Data(), fH->GetName(), fH->GetTitle(), GetNdim());
+  for( auto d : dims ) desc += Form(";p%d",d);
+  for( auto c : cuts ) desc += Form(";%d:%d-%d",c[0],c[1],c[2]);
+  TString opts = opt; opts.ToUpper();
+  desc += ";"+opts;
+  TMD5 md5;
+  md5.Update( (const UChar_t*)desc.Data(), desc.Length() );
+  md5.Final();
+  return Form("h%s", md5.AsString());
+}
+//__________________________________________________________
+// Content checksum of the source file. It is kept with the file size and mtime [ns],
+// in memory and in a stamp file of the cache directory, and the file is hashed
+// again only when stat shows another size or mtime
+TString BSTHnSparseHelper::SourceChecksum(){
+  struct stat st;
+  if( stat( fSourceFile, &st ) != 0 ) return "";
+#ifdef __APPLE__
+  Long64_t fileMtime = Long64_t(st.st_mtimespec.tv_sec)*1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  Long64_t fileMtime = Long64_t(st.st_mtim.tv_sec)*1000000000 + st.st_mtim.tv_nsec;
+#endif
+  struct Stamp { Long64_t size; Long64_t mtime; TString checksum; };
+  static std::map<TString,Stamp> stamps;
+  auto &stamp = stamps[fSourceFile];
+  if( !stamp.checksum.IsNull() && stamp.size == st.st_size && stamp.mtime == fileMtime ) return stamp.checksum;
+  TString stampFile = Form("%s/%s.%08x.stamp", CacheDir().Data(), gSystem->BaseName(fSourceFile), fSourceFile.Hash());
+  Long64_t size = -1, mtime = -1;
+  std::string checksum;
+  std::ifstream in( stampFile.Data() );
+  if( in >> size >> mtime >> checksum && size == st.st_size && mtime == fileMtime ){
+    stamp = { size, mtime, checksum.c_str() };
+    return stamp.checksum;
+  }
+  auto md5 = TMD5::FileChecksum( fSourceFile );
+  if( !md5 ) return "";
+  stamp = { Long64_t(st.st_size), fileMtime, md5->AsString() };
+  delete md5;
+  std::ofstream out( stampFile.Data() );
+  out<<stamp.size<<" "<<stamp.mtime<<" "<<stamp.checksum<<endl;
+  return stamp.checksum;
+}
+//__________________________________________________________
+// Cache file of the source file content, nullptr without cache. gDirectory is kept
+TFile * BSTHnSparseHelper::OpenCache(){
+  if( CacheDir().IsNull() || fSourceFile.IsNull() ) return nullptr;
+  gSystem->mkdir( CacheDir(), kTRUE );
+  auto checksum = SourceChecksum();
+  if( checksum.IsNull() ) return nullptr;
+  auto dir = gDirectory;
+  auto f = TFile::Open( Form("%s/%s.%s.root", CacheDir().Data(), gSystem->BaseName(fSourceFile), checksum.Data()), "UPDATE" );
+  dir->cd();
+  if( f && f->IsZombie() ){ delete f; f = nullptr; }
+  return f;
+}
+//__________________________________________________________
+// Cached projection attached to dir like Projection output, nullptr if not cached
+TH1 * BSTHnSparseHelper::ReadCache( TFile *f, TString key, TString name, TString title, TDirectory *dir ){
+  if( !f ) return nullptr;
+  auto h = dynamic_cast<TH1*>( f->Get(key) );
+  if( !h ) return nullptr;
+  h->SetDirectory( TH1::AddDirectoryStatus() ? dir : nullptr );
+  h->SetNameTitle( name, title );
+  return h;
+}
 
 //__________________________________________________________
 void BSTHnSparseHelper::SetBin( int iaxis, Double1D bins ){
@@ -302,7 +540,74 @@ void BSTHnSparseHelper::SetBin( int iaxis, Double1D bins ){
       //TODO if( ib>0 && bin <= fCBinsB[i][ib-1] ) ErrorExit("Wrong bin");
       fCBinsB[iaxis].push_back( ax->FindBin( bins[ib] ) );
     }
+    BuildCellMap( iaxis );
+  }
+}
+//__________________________________________________________
+// User bin b covers the cells fCBinsB[b] .. fCBinsB[b+1]-1, as in GetCellRange
+void BSTHnSparseHelper::BuildCellMap( int iaxis ){
+  auto &bb = fCBinsB[iaxis];
+  int nbin = bb.size()-2;
+  auto &map = fCellMap[iaxis];
+  map.assign( GetNbins(iaxis)+2, 0 );
+  for( int ic=0;ic<int(map.size());ic++ ){
+    if( ic < bb[1] ) map[ic] = 0;
+    else if( ic >= bb[nbin+1] ) map[ic] = nbin+1;
+    else map[ic] = std::upper_bound( bb.begin()+1, bb.end(), ic ) - bb.begin() - 1;
+  }
+}
+//__________________________________________________________
+// New THnSparse with the SetBin binning on every axis, filled in a single sweep
+// over fH through the cell maps. Projections of the returned helper take the same
+// bin arguments as this one, but sum only the coarse cells
+BSTHnSparseHelper BSTHnSparseHelper::GetRebinned( TString name ){
+  if( name.EndsWith("-") ) name+=Form("%sRebin",fH->GetName());
+  int ndim = GetNdim();
+  // coarse edges on the cell edges actually summed, the SetBin values may fall inside cells
+  Int1D nbins;
+  Double1D xmin, xmax;
+  Double2D edges(ndim);
+  for( int i=0;i<ndim;i++ ){
+    for( UInt_t k=1;k<fCBinsB[i].size();k++ ) edges[i].push_back( GetAxis(i)->GetBinLowEdge( fCBinsB[i][k] ) );
+    nbins.push_back( edges[i].size()-1 );
+    xmin.push_back( edges[i].front() );
+    xmax.push_back( edges[i].back() );
   }
+  auto h = new THnSparseD( name, fH->GetTitle(), ndim, nbins.data(), xmin.data(), xmax.data() );
+  for( int i=0;i<ndim;i++ ){
+    auto ax = GetAxis(i);
+    auto rax = h->GetAxis(i);
+    h->SetBinEdges( i, edges[i].data() );
+    rax->SetName( ax->GetName() );
+    rax->SetTitle( ax->GetTitle() );
+    // labels survive where the binning is the one of fH
+    if( nbins[i] == ax->GetNbins() && fCBinsB[i][1] == 1 )
+      for( int ib=1;ib<=nbins[i];ib++ ){
+        const char * label = ax->GetBinLabel(ib);
+        if( !TString(label).IsNull() ) rax->SetBinLabel( ib, label );
+      }
+  }
+
+  bool haveErrors = fH->GetCalculateErrors();
+  if( haveErrors ) h->Sumw2();
+  Int1D coord(ndim), rcoord(ndim);
+  for( Long64_t ibin=0;ibin<fH->GetNbins();ibin++ ){
+    double v = fH->GetBinContent( ibin, coord.data() );
+    for( int i=0;i<ndim;i++ ) rcoord[i] = fCellMap[i][coord[i]];
+    auto rbin = h->GetBin( rcoord.data() );
+    h->AddBinContent( rbin, v );
+    if( haveErrors ) h->AddBinError2( rbin, fH->GetBinError2( ibin ) );
+  }
+  h->SetEntries( fH->GetEntries() );
+
+  BSTHnSparseHelper view( h );
+  TString binning;
+  for( auto &bb : fCBinsB ){
+    binning += ";";
+    for( auto b : bb ) binning += Form("%d,",b);
+  }
+  view.SetSource( fSourceFile, fObjectPath+"/"+fH->GetName()+binning );
+  return view;
 }
 //__________________________________________________________
 void BSTHnSparseHelper::SetBin( Double2D bins ){
@@ -325,26 +630,334 @@ BSTHnSparseHelper BSTHnSparseHelper::Load( TString name, TString fname, TString
   TObject * cl = f;
   if( ! lname.IsNull() )
     cl = f->Get(lname);
-  return Load(name, cl);
+  auto h = Load(name, cl);
+  h.SetSource( f->GetName(), lname );
+  return h;
 }
 
 //__________________________________________________________
 void BSTHnSparseHelper::LoadBinFromHist( int iaxis){
   auto ax = GetAxis(iaxis);
+  fCBins[iaxis].clear();
   fCBinsB[iaxis] = {0};
   for( int ib=1;ib<=ax->GetNbins()+1;ib++ ){
     fCBins[iaxis].push_back( ax->GetBinLowEdge(ib) );
     fCBinsB[iaxis].push_back( ib );
   }
+  BuildCellMap( iaxis );
 }
 //__________________________________________________________
 void BSTHnSparseHelper::LoadBinFromHist(){
   fCBins.resize( GetNdim() );
   fCBinsB.resize( GetNdim() );
+  fCellMap.resize( GetNdim() );
   for( int i=0;i<GetNdim();i++ )
     LoadBinFromHist(i);
 }
 
+//==========================
+//  COLUMNS
+//==========================
+// File layout of BSTHnSparseHelper::ExportColumns, every block 8 byte aligned :
+// header, ( axis, nbins+1 low edges ) x ndim, Int_t coordinate column x ndim,
+// Double_t content column, Double_t error2 column if hasErrors
+struct BSColumnsHeader {
+  char     magic[8] = "BSCOLS1";
+  Int_t    ndim = 0;
+  Int_t    hasErrors = 0;
+  Long64_t nfilled = 0;
+  Double_t entries = 0;
+  Double_t sumw = 0;    // sum of the content column
+  char     name[128] = {0};
+  char     title[256] = {0};
+  static size_t Padding( size_t size ){ return (8-size%8)%8; }
+};
+struct BSColumnsAxis {
+  Int_t nbins = 0;
+  Int_t reserved = 0;
+  char  name[64] = {0};
+  char  title[64] = {0};
+};
+
+// Memory mapped reader of ExportColumns files. Only the pages touched by a query
+// are read, and a cut on axis 0 is a binary search on the sorted first column.
+// Cells follow TAxis : 0 underflow, nbins+1 overflow; cells[i] = {first,last}
+// selects axis i, an empty or missing entry keeps the whole axis
+class BSSparseColumns {
+public:
+  BSSparseColumns( TString fileName );
+  BSSparseColumns( const BSSparseColumns& ) = delete;
+  BSSparseColumns& operator=( const BSSparseColumns& ) = delete;
+  ~BSSparseColumns(){ if( fData ) munmap( fData, fSize ); }
+
+  int      GetNdim(){ return fHeader->ndim; }
+  Long64_t GetNfilled(){ return fHeader->nfilled; }
+  Double_t GetEntries(){ return fHeader->entries; }
+  TString  GetName(){ return fHeader->name; }
+  int      GetAxisID( TString name );
+  int      GetNbins( int i ){ return fAxes[i]->nbins; }
+  const Double_t * GetEdges( int i ){ return fEdges[i]; }
+  const Int_t    * GetCoord( int i ){ return fCoords[i]; }
+  const Double_t * GetContent(){ return fContent; }
+  const Double_t * GetError2(){ return fError2; }
+
+  Double_t Integral( Int2D cells );
+  TH1D * GetTH1( TString name, Int_t xDim, Int2D cells, Option_t*opt="" ){ return (TH1D*)Project( name, xDim, -1, cells, opt ); }
+  TH2D * GetTH2( TString name, Int_t xDim, Int_t yDim, Int2D cells, Option_t*opt="" ){ return (TH2D*)Project( name, xDim, yDim, cells, opt ); }
+private:
+  template< class F > void Loop( Int2D cells, Int1D skip, F func );
+  TH1 * Project( TString name, Int_t xDim, Int_t yDim, Int2D cells, Option_t*opt );
+
+  char   * fData = nullptr;
+  size_t   fSize = 0;
+  const BSColumnsHeader * fHeader;
+  vector<const BSColumnsAxis*> fAxes;
+  vector<const Double_t*> fEdges;
+  vector<const Int_t*>    fCoords;
+  const Double_t * fContent;
+  const Double_t * fError2 = nullptr;
+};
+
+//__________________________________________________________
+BSSparseColumns::BSSparseColumns( TString fileName ){
+  int fd = open( fileName.Data(), O_RDONLY );
+  if( fd < 0 ) ErrorExit( "No File : "+fileName );
+  struct stat st;
+  fstat( fd, &st );
+  fSize = st.st_size;
+  void * data = fSize ? mmap( nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0 ) : MAP_FAILED;
+  close( fd );
+  if( data == MAP_FAILED ) ErrorExit( "Cannot map "+fileName );
+  fData = (char*)data;
+
+  size_t offset = 0;
+  auto take = [&]( size_t size ){
+    if( offset+size > fSize ) ErrorExit( "Truncated columns in "+fileName );
+    auto p = fData+offset;
+    offset += size + BSColumnsHeader::Padding( size );
+    return p;
+  };
+  fHeader = (const BSColumnsHeader*)take( sizeof(BSColumnsHeader) );
+  if( strcmp( fHeader->magic, BSColumnsHeader().magic ) ) ErrorExit( fileName+" is not a columns file" );
+  Long64_t n = fHeader->nfilled;
+  for( int i=0;i<GetNdim();i++ ){
+    fAxes.push_back( (const BSColumnsAxis*)take( sizeof(BSColumnsAxis) ) );
+    fEdges.push_back( (const Double_t*)take( (fAxes[i]->nbins+1)*sizeof(Double_t) ) );
+  }
+  for( int i=0;i<GetNdim();i++ ) fCoords.push_back( (const Int_t*)take( n*sizeof(Int_t) ) );
+  fContent = (const Double_t*)take( n*sizeof(Double_t) );
+  if( fHeader->hasErrors ) fError2 = (const Double_t*)take( n*sizeof(Double_t) );
+}
+//__________________________________________________________
+int BSSparseColumns::GetAxisID( TString name ){
+  for( int i=0;i<GetNdim();i++ )
+    if( name == fAxes[i]->name ) return i;
+  ErrorExit("No Axis "+name);
+  return -1;
+}
+//__________________________________________________________
+// func( row ) for all rows inside cells, axes in skip are not cut
+template< class F >
+void BSSparseColumns::Loop( Int2D cells, Int1D skip, F func ){
+  cells.resize( GetNdim() );
+  for( auto i : skip ) cells[i].clear();
+  Long64_t begin = 0, end = GetNfilled();
+  if( cells[0].size() == 2 ){
+    begin = std::lower_bound( fCoords[0], fCoords[0]+end, cells[0][0] ) - fCoords[0];
+    end   = std::upper_bound( fCoords[0], fCoords[0]+end, cells[0][1] ) - fCoords[0];
+  }
+  Int1D cut;
+  for( int i=1;i<GetNdim();i++ )
+    if( cells[i].size() == 2 ) cut.push_back(i);
+  for( Long64_t row=begin;row<end;row++ ){
+    bool pass = true;
+    for( auto i : cut )
+      if( fCoords[i][row] < cells[i][0] || fCoords[i][row] > cells[i][1] ){ pass = false; break; }
+    if( pass ) func( row );
+  }
+}
+//__________________________________________________________
+Double_t BSSparseColumns::Integral( Int2D cells ){
+  Double_t sum = 0;
+  Loop( cells, {}, [&]( Long64_t row ){ sum += fContent[row]; } );
+  return sum;
+}
+//__________________________________________________________
+// Projection on xDim ( and yDim ) taken in full, with errors when the columns have
+// them or with opt "E"
+TH1 * BSSparseColumns::Project( TString name, Int_t xDim, Int_t yDim, Int2D cells, Option_t*opt ){
+  TString opts = opt; opts.ToUpper();
+  bool wantErrors = fError2 || opts.Contains("E");
+  if( name.EndsWith("-") ) name+=Form("%sP%02d",GetName().Data(),xDim);
+  TH1 * h;
+  if( yDim<0 ) h = new TH1D( name, fHeader->title, GetNbins(xDim), GetEdges(xDim) );
+  else         h = new TH2D( name, fHeader->title, GetNbins(xDim), GetEdges(xDim), GetNbins(yDim), GetEdges(yDim) );
+  h->GetXaxis()->SetTitle( fAxes[xDim]->title );
+  if( yDim>=0 ) h->GetYaxis()->SetTitle( fAxes[yDim]->title );
+  if( wantErrors ) h->Sumw2();
+
+  int nx = GetNbins(xDim)+2;
+  Double1D sumw( nx*( yDim<0 ? 1 : GetNbins(yDim)+2 ), 0 ), sumw2( wantErrors ? sumw.size() : 0, 0 );
+  Double_t sum = 0;
+  Int1D skip = {xDim};
+  if( yDim>=0 ) skip.push_back(yDim);
+  Loop( cells, skip, [&]( Long64_t row ){
+    int gbin = fCoords[xDim][row] + ( yDim<0 ? 0 : nx*fCoords[yDim][row] );
+    sumw[gbin] += fContent[row];
+    if( wantErrors ) sumw2[gbin] += fError2 ? fError2[row] : fContent[row];
+    sum += fContent[row];
+  });
+  for( UInt_t gbin=0;gbin<sumw.size();gbin++ ){
+    if( sumw[gbin] == 0 && ( !wantErrors || sumw2[gbin] == 0 ) ) continue;
+    h->SetBinContent( gbin, sumw[gbin] );
+    if( wantErrors ) h->SetBinError( gbin, TMath::Sqrt(sumw2[gbin]) );
+  }
+  // entries scaled to the selected content, as GetProjections
+  h->SetEntries( fHeader->sumw != 0 ? GetEntries()*sum/fHeader->sumw : GetEntries() );
+  return h;
+}
+
+//__________________________________________________________
+// Filled bins of fH as columns for BSSparseColumns : one coordinate column per
+// axis and the content ( and error2 ) column, sorted by coordinates with axis 0 first
+void BSTHnSparseHelper::ExportColumns( TString fileName ){
+  int ndim = GetNdim();
+  Long64_t nfilled = fH->GetNbins();
+  bool haveErrors = fH->GetCalculateErrors();
+  Int1D coords( nfilled*ndim );
+  Double1D content( nfilled ), error2( haveErrors ? nfilled : 0 );
+  for( Long64_t ibin=0;ibin<nfilled;ibin++ ){
+    content[ibin] = fH->GetBinContent( ibin, &coords[ibin*ndim] );
+    if( haveErrors ) error2[ibin] = fH->GetBinError2( ibin );
+  }
+  vector<Long64_t> order( nfilled );
+  std::iota( order.begin(), order.end(), 0 );
+  std::sort( order.begin(), order.end(), [&]( Long64_t a, Long64_t b ){
+    return std::lexicographical_compare( &coords[a*ndim], &coords[a*ndim]+ndim, &coords[b*ndim], &coords[b*ndim]+ndim );
+  });
+
+  std::ofstream out( fileName.Data(), std::ios::binary );
+  if( !out ) ErrorExit( "Cannot write "+fileName );
+  BSColumnsHeader header;
+  header.ndim = ndim;
+  header.hasErrors = haveErrors;
+  header.nfilled = nfilled;
+  header.entries = fH->GetEntries();
+  header.sumw = std::accumulate( content.begin(), content.end(), 0. );
+  strncpy( header.name, fH->GetName(), sizeof(header.name)-1 );
+  strncpy( header.title, fH->GetTitle(), sizeof(header.title)-1 );
+  out.write( (const char*)&header, sizeof(header) );
+  for( int i=0;i<ndim;i++ ){
+    auto ax = GetAxis(i);
+    BSColumnsAxis axis;
+    axis.nbins = ax->GetNbins();
+    strncpy( axis.name, ax->GetName(), sizeof(axis.name)-1 );
+    strncpy( axis.title, ax->GetTitle(), sizeof(axis.title)-1 );
+    out.write( (const char*)&axis, sizeof(axis) );
+    for( int ib=1;ib<=ax->GetNbins()+1;ib++ ){
+      Double_t edge = ax->GetBinLowEdge(ib);
+      out.write( (const char*)&edge, sizeof(edge) );
+    }
+  }
+  const char pad[8] = {0};
+  for( int i=0;i<ndim;i++ ){
+    for( auto ibin : order ) out.write( (const char*)&coords[ibin*ndim+i], sizeof(Int_t) );
+    out.write( pad, BSColumnsHeader::Padding( nfilled*sizeof(Int_t) ) );
+  }
+  for( auto ibin : order ) out.write( (const char*)&content[ibin], sizeof(Double_t) );
+  if( haveErrors )
+    for( auto ibin : order ) out.write( (const char*)&error2[ibin], sizeof(Double_t) );
+  if( !out ) ErrorExit( "Cannot write "+fileName );
+}
+
+//==========================
+//  PARALLEL JOBS
+//==========================
+// Independent projection + fit jobs on ROOT::TThreadExecutor, results in Submit order.
+// The projections of one THnSparse are made in GetProjections sweeps on one thread,
+// different THnSparse are swept in parallel, then all fit functions run in parallel.
+// A fit function gets its own histogram and must make its own TF1 ( fit with the
+// TF1 pointer and "Q0", not by name ). Histograms are attached to gDirectory of Run.
+//
+//   BSParallelJobs<double> jobs;
+//   for( auto c : mc_v0mass.BinRange("Centrality") )
+//     jobs.Submit( &mc_v0mass, {"-", 2, {kINEL, kK0short, c}}, FitYield );
+//   auto yields = jobs.Run();
+template< class R >
+class BSParallelJobs {
+public:
+  BSParallelJobs( UInt_t nthreads=0 ):fNthreads(nthreads){}
+  int Submit( BSTHnSparseHelper *helper, BSProjSpec spec, std::function<R(TH1*)> fit ){
+    fJobs.push_back({ helper, spec, fit, nullptr });
+    return fJobs.size()-1;
+  }
+  int Submit( std::function<R()> job ){ return Submit( nullptr, BSProjSpec("", 0, Int1D{}), [job](TH1*){ return job(); } ); }
+  TH1 * GetHist( int i ){ return fJobs[i].hist; }
+  UInt_t GetNjobs(){ return fJobs.size(); }
+  vector<R> Run( Option_t *opt="" );
+private:
+  struct Job {
+    BSTHnSparseHelper *helper;
+    BSProjSpec spec;
+    std::function<R(TH1*)> fit;
+    TH1 * hist;
+  };
+  UInt_t      fNthreads; // 0 : all cores
+  vector<Job> fJobs;
+};
+
+//__________________________________________________________
+template< class R >
+vector<R> BSParallelJobs<R>::Run( Option_t *opt ){
+  ROOT::EnableThreadSafety();
+  ROOT::TThreadExecutor pool( fNthreads );
+  auto dir = gDirectory;
+  bool addDirectory = TH1::AddDirectoryStatus();
+  TH1::AddDirectory( kFALSE );
+
+  //== jobs grouped by THnSparse, helpers on the same THnSparse run in turn
+  vector<THnSparse*> sources;
+  vector<Int1D> groups;
+  for( UInt_t i=0;i<fJobs.size();i++ ){
+    if( !fJobs[i].helper ) continue;
+    auto it = std::find( sources.begin(), sources.end(), fJobs[i].helper->Data() );
+    if( it == sources.end() ){
+      sources.push_back( fJobs[i].helper->Data() );
+      groups.push_back( {} );
+      it = sources.end()-1;
+    }
+    groups[it-sources.begin()].push_back(i);
+  }
+  Int1D igroups;
+  for( UInt_t ig=0;ig<groups.size();ig++ ) igroups.push_back(ig);
+  pool.Foreach( [&]( int ig ){
+    Int1D todo = groups[ig];
+    while( !todo.empty() ){
+      auto helper = fJobs[todo[0]].helper;
+      Int1D ijobs, rest;
+      vector<BSProjSpec> specs;
+      for( auto i : todo ){
+        if( fJobs[i].helper == helper ){ ijobs.push_back(i); specs.push_back( fJobs[i].spec ); }
+        else rest.push_back(i);
+      }
+      auto hists = helper->GetProjections( specs, opt );
+      for( UInt_t k=0;k<ijobs.size();k++ ) fJobs[ijobs[k]].hist = hists[k];
+      todo = rest;
+    }
+  }, igroups );
+
+  //== fits
+  Int1D ijobs;
+  for( UInt_t i=0;i<fJobs.size();i++ ) ijobs.push_back(i);
+  auto results = pool.Map( [&]( int i ){ return fJobs[i].fit( fJobs[i].hist ); }, ijobs );
+
+  TH1::AddDirectory( addDirectory );
+  if( addDirectory )
+    for( auto &job : fJobs )
+      if( job.hist ) job.hist->SetDirectory( dir );
+  return results;
+}
+
 //==========================
 //  DRAWING
 //==========================
@@ -1,3 +1,6 @@
+#ifndef FTHIT_HH
+#define FTHIT_HH
+
 // #include "KBHit.hh"
 #include "KBTpcHit.hh"
 #include "KBTask.hh"
@@ -15,3 +18,5 @@ class FTHit : public KBTpcHit // , public KBTpcHit // , public KBTask
 		double reco_y;
 		double reco_z;
 };
+
+#endif
@@ -0,0 +1,6 @@
+#include "LHAllocationCounter.hh"
+
+#include <dlfcn.h>
+
+// lh_count_allocations.c, if preloaded
+Long64_t (*LHAllocationCounter::fCountFunction)() = (Long64_t(*)())dlsym(RTLD_DEFAULT, "lh_num_heap_allocations");
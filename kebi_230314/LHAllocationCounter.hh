@@ -0,0 +1,27 @@
+#ifndef LHALLOCATIONCOUNTER_HH
+#define LHALLOCATIONCOUNTER_HH
+
+#include "Rtypes.h"
+
+/**
+ * Heap allocation count of the process, used by the LH tasks to report
+ * allocations per event. The library does not count by itself: the count
+ * comes from a hook of the test harness, either set with SetCountFunction or
+ * found at load time when lh_count_allocations.c is preloaded
+ * (LD_PRELOAD=./liblh_count_allocations.so root ...). Without a hook
+ * IsEnabled() is false and GetCount() returns -1.
+ */
+class LHAllocationCounter
+{
+public:
+  /// Use count as the allocation count, nullptr to disable counting
+  static void SetCountFunction(Long64_t (*count)()) { fCountFunction = count; }
+
+  static bool IsEnabled() { return fCountFunction != nullptr; }
+  static Long64_t GetCount() { return fCountFunction == nullptr ? -1 : fCountFunction(); }
+
+private:
+  static Long64_t (*fCountFunction)();
+};
+
+#endif
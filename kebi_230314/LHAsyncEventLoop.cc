@@ -0,0 +1,395 @@
+#include "LHAsyncEventLoop.hh"
+#include "LHRunContext.hh"
+
+#include "TROOT.h"
+
+#include <chrono>
+
+static Double_t SecondsSince(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<Double_t>(chrono::steady_clock::now() - start).count();
+}
+
+LHEventPrefetcher::~LHEventPrefetcher()
+{
+  Stop();
+  DeleteSlots();
+  delete fFile;
+}
+
+void LHEventPrefetcher::DeleteSlots()
+{
+  for (auto &slot : fSlots)
+    for (auto array : slot.fArrays)
+      delete array;
+  fSlots.clear();
+}
+
+bool LHEventPrefetcher::Open(TString fileName, TString treeName)
+{
+  Stop();
+  delete fFile;
+  fTree = nullptr;
+
+  fFile = TFile::Open(fileName);
+  if (fFile == nullptr || fFile->IsZombie())
+  {
+    kb_error << "Cannot open input file " << fileName << endl;
+    return false;
+  }
+
+  fTree = (TTree *)fFile->Get(treeName);
+  if (fTree == nullptr)
+  {
+    kb_error << "No tree " << treeName << " in " << fileName << endl;
+    return false;
+  }
+
+  fTree->SetBranchStatus("*", false);
+  fTreeBranches.clear();
+  fReadArrays.assign(fBranches.size(), nullptr);
+  for (UInt_t iBranch = 0; iBranch < fBranches.size(); ++iBranch)
+  {
+    auto name = fBranches[iBranch].fName;
+    fTree->SetBranchStatus(name + "*", true);
+    auto branch = fTree->GetBranch(name);
+    if (branch == nullptr)
+    {
+      kb_error << "No branch " << name << " in " << fileName << endl;
+      return false;
+    }
+    fTreeBranches.push_back(branch);
+  }
+
+  return true;
+}
+
+void LHEventPrefetcher::Start(Long64_t numEntries, Int_t numSlots)
+{
+  Stop();
+
+  ROOT::EnableThreadSafety();
+
+  fNumEntries = numEntries;
+  fStop = false;
+  fWaitTime = 0;
+  fReadTime = 0;
+
+  fSlots.resize(numSlots < 1 ? 1 : numSlots);
+  for (auto &slot : fSlots)
+  {
+    slot.fEntry = -1;
+    slot.fState = kSlotFree;
+    if (slot.fArrays.empty())
+      for (auto &branch : fBranches)
+        slot.fArrays.push_back(new TClonesArray(branch.fClassName));
+  }
+
+  fThread = thread(&LHEventPrefetcher::ReadLoop, this);
+}
+
+void LHEventPrefetcher::ReadLoop()
+{
+  Int_t numSlots = fSlots.size();
+  for (Long64_t entry = 0; entry < fNumEntries; ++entry)
+  {
+    auto &slot = fSlots[entry % numSlots];
+    {
+      unique_lock<mutex> lock(fMutex);
+      fSlotFreed.wait(lock, [&]() { return fStop || slot.fState == kSlotFree; });
+      if (fStop)
+        return;
+    }
+
+    // the slot is owned by this thread until it is marked as read
+    auto start = chrono::steady_clock::now();
+    for (UInt_t iBranch = 0; iBranch < fBranches.size(); ++iBranch)
+    {
+      fReadArrays[iBranch] = slot.fArrays[iBranch];
+      fTreeBranches[iBranch]->SetAddress(&fReadArrays[iBranch]);
+    }
+    fTree->GetEntry(entry);
+    fReadTime += SecondsSince(start);
+
+    {
+      lock_guard<mutex> lock(fMutex);
+      slot.fEntry = entry;
+      slot.fState = kSlotRead;
+    }
+    fSlotRead.notify_all();
+  }
+}
+
+bool LHEventPrefetcher::Take(Long64_t entry, const vector<TClonesArray *> &targets)
+{
+  if (entry >= fNumEntries)
+    return false;
+
+  auto &slot = fSlots[entry % fSlots.size()];
+  {
+    auto start = chrono::steady_clock::now();
+    unique_lock<mutex> lock(fMutex);
+    fSlotRead.wait(lock, [&]() { return fStop || (slot.fState == kSlotRead && slot.fEntry == entry); });
+    fWaitTime += SecondsSince(start);
+    if (fStop)
+      return false;
+  }
+
+  for (UInt_t iBranch = 0; iBranch < fBranches.size(); ++iBranch)
+    fBranches[iBranch].fCopy(slot.fArrays[iBranch], targets[iBranch]);
+
+  {
+    lock_guard<mutex> lock(fMutex);
+    slot.fState = kSlotFree;
+  }
+  fSlotFreed.notify_all();
+
+  return true;
+}
+
+void LHEventPrefetcher::Stop()
+{
+  {
+    lock_guard<mutex> lock(fMutex);
+    fStop = true;
+  }
+  fSlotFreed.notify_all();
+  fSlotRead.notify_all();
+
+  if (fThread.joinable())
+    fThread.join();
+}
+
+LHEventWriter::~LHEventWriter()
+{
+  Close();
+  DeleteSlots();
+}
+
+void LHEventWriter::DeleteSlots()
+{
+  for (auto &slot : fSlots)
+    for (auto array : slot.fArrays)
+      delete array;
+  fSlots.clear();
+}
+
+bool LHEventWriter::Open(TString fileName, TString treeName, Int_t numSlots)
+{
+  Close();
+
+  ROOT::EnableThreadSafety();
+
+  fFile = new TFile(fileName, "recreate");
+  if (fFile->IsZombie())
+  {
+    kb_error << "Cannot open output file " << fileName << endl;
+    delete fFile;
+    fFile = nullptr;
+    return false;
+  }
+
+  DeleteSlots();
+  fSlots.resize(numSlots < 1 ? 1 : numSlots);
+  for (auto &slot : fSlots)
+    for (auto &branch : fBranches)
+      slot.fArrays.push_back(new TClonesArray(branch.fClassName));
+
+  // the writer thread points the branches to the slot of each event before filling
+  fTree = new TTree(treeName, "");
+  fTreeBranches.clear();
+  fFillArrays = fSlots[0].fArrays;
+  for (UInt_t iBranch = 0; iBranch < fBranches.size(); ++iBranch)
+    fTreeBranches.push_back(fTree->Branch(fBranches[iBranch].fName, &fFillArrays[iBranch]));
+
+  fNextEvent = 0;
+  fNumWrittenEvents = 0;
+  fClose = false;
+  fWaitTime = 0;
+  fWriteTime = 0;
+  fThread = thread(&LHEventWriter::WriteLoop, this);
+
+  return true;
+}
+
+LHEventWriter::Slot &LHEventWriter::AcquireSlot(Long64_t event, unique_lock<mutex> &lock)
+{
+  // a free slot may still be waiting for an earlier event of the same slot (a slow producer),
+  // so event only takes it once every event before event - numSlots is written
+  Long64_t numSlots = fSlots.size();
+  auto &slot = fSlots[event % numSlots];
+  auto start = chrono::steady_clock::now();
+  fSlotFreed.wait(lock, [&]() { return slot.fState == kSlotFree && event < fNextEvent + numSlots; });
+  fWaitTime += SecondsSince(start);
+  return slot;
+}
+
+void LHEventWriter::Push(Long64_t event, const vector<TClonesArray *> &sources)
+{
+  if (fThread.get_id() == thread::id())
+    return;
+
+  unique_lock<mutex> lock(fMutex);
+  auto &slot = AcquireSlot(event, lock);
+  lock.unlock();
+
+  for (UInt_t iBranch = 0; iBranch < fBranches.size(); ++iBranch)
+    fBranches[iBranch].fCopy(sources[iBranch], slot.fArrays[iBranch]);
+
+  lock.lock();
+  slot.fEvent = event;
+  slot.fState = kSlotQueued;
+  lock.unlock();
+  fSlotQueued.notify_all();
+}
+
+void LHEventWriter::Skip(Long64_t event)
+{
+  if (fThread.get_id() == thread::id())
+    return;
+
+  unique_lock<mutex> lock(fMutex);
+  auto &slot = AcquireSlot(event, lock);
+  slot.fEvent = event;
+  slot.fState = kSlotSkipped;
+  lock.unlock();
+  fSlotQueued.notify_all();
+}
+
+void LHEventWriter::WriteLoop()
+{
+  Int_t numSlots = fSlots.size();
+  while (true)
+  {
+    auto &slot = fSlots[fNextEvent % numSlots];
+    {
+      unique_lock<mutex> lock(fMutex);
+      fSlotQueued.wait(lock, [&]() { return fClose || (slot.fState != kSlotFree && slot.fEvent == fNextEvent); });
+      if (slot.fState == kSlotFree || slot.fEvent != fNextEvent)
+        return; // closed and nothing left in order
+    }
+
+    if (slot.fState == kSlotQueued)
+    {
+      auto start = chrono::steady_clock::now();
+      for (UInt_t iBranch = 0; iBranch < fBranches.size(); ++iBranch)
+      {
+        fFillArrays[iBranch] = slot.fArrays[iBranch];
+        fTreeBranches[iBranch]->SetAddress(&fFillArrays[iBranch]);
+      }
+      fTree->Fill();
+      fWriteTime += SecondsSince(start);
+      ++fNumWrittenEvents;
+    }
+
+    {
+      lock_guard<mutex> lock(fMutex);
+      slot.fState = kSlotFree;
+      ++fNextEvent;
+    }
+    fSlotFreed.notify_all();
+  }
+}
+
+void LHEventWriter::Close()
+{
+  if (fThread.joinable())
+  {
+    {
+      lock_guard<mutex> lock(fMutex);
+      fClose = true;
+    }
+    fSlotQueued.notify_all();
+    fThread.join();
+  }
+
+  if (fFile == nullptr)
+    return;
+
+  fFile->cd();
+  fTree->Write();
+  if (fCloseAction)
+    fCloseAction(fFile);
+  fFile->Close(); // deletes fTree
+  delete fFile;
+  fFile = nullptr;
+  fTree = nullptr;
+  fTreeBranches.clear();
+  fFillArrays.clear();
+}
+
+LHAsyncEventLoop::~LHAsyncEventLoop()
+{
+  for (auto array : fInputArrays)
+    delete array;
+}
+
+bool LHAsyncEventLoop::Init()
+{
+  if (!fPrefetcher.Open(fInputFileName, fInputTreeName))
+    return false;
+
+  auto run = KBRun::GetRun();
+  for (auto array : fInputArrays)
+    delete array;
+  fInputArrays.clear();
+  for (auto &branch : fPrefetcher.GetBranches())
+  {
+    auto array = new TClonesArray(branch.fClassName);
+    run->RegisterBranch(branch.fName, array, false);
+    fInputArrays.push_back(array);
+  }
+
+  return true;
+}
+
+void LHAsyncEventLoop::Run(Long64_t numEvents)
+{
+  auto run = KBRun::GetRun();
+
+  fOutputArrays.clear();
+  for (auto &branch : fWriter.GetBranches())
+  {
+    auto array = (TClonesArray *)run->GetBranch(branch.fName);
+    if (array == nullptr)
+    {
+      kb_error << "No output branch " << branch.fName << " registered in KBRun" << endl;
+      return;
+    }
+    fOutputArrays.push_back(array);
+  }
+
+  if (numEvents < 0 || numEvents > fPrefetcher.GetEntries())
+    numEvents = fPrefetcher.GetEntries();
+
+  bool useWriter = !fOutputFileName.IsNull() && !fOutputArrays.empty();
+  if (useWriter && !fWriter.Open(fOutputFileName, fOutputTreeName, fNumOutputEvents))
+    return;
+
+  auto start = chrono::steady_clock::now();
+  fPrefetcher.Start(numEvents, fNumPrefetchEvents);
+
+  for (Long64_t iEvent = 0; iEvent < numEvents; ++iEvent)
+  {
+    if (!fPrefetcher.Take(iEvent, fInputArrays))
+      break;
+
+    // KBRun::Run does not run in this mode, so its current event ID does not advance
+    LHRunContext::SetEventID(iEvent);
+    run->ExecuteTasks("");
+
+    if (useWriter)
+      fWriter.Push(iEvent, fOutputArrays);
+  }
+
+  LHRunContext::SetEventID(-1);
+  fPrefetcher.Stop();
+  if (useWriter)
+    fWriter.Close();
+  fRealTime = SecondsSince(start);
+
+  kb_info << "Processed " << numEvents << " events in " << fRealTime << " s" << endl;
+  kb_info << "  input  : read " << fPrefetcher.GetReadTime() << " s, waited " << fPrefetcher.GetWaitTime() << " s" << endl;
+  if (useWriter)
+    kb_info << "  output : fill " << fWriter.GetWriteTime() << " s, waited " << fWriter.GetWaitTime() << " s" << endl;
+}
@@ -0,0 +1,266 @@
+#ifndef LHASYNCEVENTLOOP_HH
+#define LHASYNCEVENTLOOP_HH
+
+#include "TClonesArray.h"
+#include "TFile.h"
+#include "TTree.h"
+
+#include "KBHelixTrack.hh"
+#include "KBRun.hh"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/// One TClonesArray branch handled by LHEventPrefetcher or LHEventWriter.
+struct LHEventBranch
+{
+  TString fName;
+  TString fClassName;
+  void (*fCopy)(TClonesArray *source, TClonesArray *target);
+
+  /// Member-wise copy into the objects kept by target, no allocation once target has grown
+  template <class T>
+  static void CopyArray(TClonesArray *source, TClonesArray *target)
+  {
+    target->Clear("C");
+    Int_t numObjects = source->GetEntriesFast();
+    for (Int_t iObject = 0; iObject < numObjects; ++iObject)
+      *(T *)target->ConstructedAt(iObject) = *(T *)source->At(iObject);
+  }
+};
+
+/**
+ * KBHelixTrack keeps pointers to hits of the task arrays, which are reused by the
+ * next event. The copy takes the hit IDs from them with FinalizeHits and keeps
+ * only the persistent members.
+ */
+template <>
+inline void LHEventBranch::CopyArray<KBHelixTrack>(TClonesArray *source, TClonesArray *target)
+{
+  target->Clear("C");
+  Int_t numObjects = source->GetEntriesFast();
+  for (Int_t iObject = 0; iObject < numObjects; ++iObject)
+  {
+    auto track = (KBHelixTrack *)target->ConstructedAt(iObject);
+    *track = *(KBHelixTrack *)source->At(iObject);
+    track->FinalizeHits();
+    track->GetHitArray()->Clear();
+  }
+}
+
+/**
+ * Reads and deserializes input entries on a background thread.
+ *
+ * Entry e is read into slot e % numSlots as soon as the consumer has released
+ * the entry read numSlots before it. Take copies a read entry into the caller's
+ * arrays and releases the slot, so the reader can run ahead of event
+ * processing by up to numSlots entries. Several consumers may call Take
+ * concurrently for different entries.
+ */
+class LHEventPrefetcher
+{
+public:
+  LHEventPrefetcher() {}
+  virtual ~LHEventPrefetcher();
+
+  template <class T>
+  void AddBranch(TString name) { fBranches.push_back({name, T::Class_Name(), &LHEventBranch::CopyArray<T>}); }
+
+  const vector<LHEventBranch> &GetBranches() const { return fBranches; }
+
+  bool Open(TString fileName, TString treeName = "event");
+  Long64_t GetEntries() const { return fTree == nullptr ? 0 : fTree->GetEntries(); }
+
+  void Start(Long64_t numEntries, Int_t numSlots = 2);
+  /// Wait for entry and copy its branches into targets (same order as AddBranch). False after the last entry.
+  bool Take(Long64_t entry, const vector<TClonesArray *> &targets);
+  void Stop();
+
+  Double_t GetWaitTime() const { return fWaitTime; } ///< time consumers spent waiting for the reader [s]
+  Double_t GetReadTime() const { return fReadTime; } ///< time the reader spent in TTree::GetEntry [s]
+
+private:
+  enum SlotState
+  {
+    kSlotFree,
+    kSlotRead,
+  };
+
+  struct Slot
+  {
+    Long64_t fEntry = -1;
+    SlotState fState = kSlotFree;
+    vector<TClonesArray *> fArrays;
+  };
+
+  void ReadLoop();
+  void DeleteSlots();
+
+  vector<LHEventBranch> fBranches;
+  TFile *fFile = nullptr;
+  TTree *fTree = nullptr;
+  vector<TBranch *> fTreeBranches;
+  vector<TClonesArray *> fReadArrays; ///< addresses given to fTreeBranches
+
+  vector<Slot> fSlots;
+  Long64_t fNumEntries = 0;
+  bool fStop = false;
+  mutex fMutex;
+  condition_variable fSlotFreed;
+  condition_variable fSlotRead;
+  thread fThread;
+
+  Double_t fWaitTime = 0;
+  Double_t fReadTime = 0;
+};
+
+/**
+ * Writes output entries on a background thread.
+ *
+ * Push copies the given arrays into slot event % numSlots and returns; the
+ * writer thread fills the tree strictly in event order, so events may be
+ * pushed out of order by several producers.
+ */
+class LHEventWriter
+{
+public:
+  LHEventWriter() {}
+  virtual ~LHEventWriter();
+
+  template <class T>
+  void AddBranch(TString name) { fBranches.push_back({name, T::Class_Name(), &LHEventBranch::CopyArray<T>}); }
+
+  const vector<LHEventBranch> &GetBranches() const { return fBranches; }
+
+  bool Open(TString fileName, TString treeName = "event", Int_t numSlots = 4);
+  /// Copy sources (same order as AddBranch) as event; blocks until the events up to event - numSlots are written
+  void Push(Long64_t event, const vector<TClonesArray *> &sources);
+  /// Skip event without output, so later events are not held back
+  void Skip(Long64_t event);
+  /// Write all queued events, call the close action and close the file
+  void Close();
+  /// Called by Close with the output file, after the tree is written and before the file is closed
+  void SetCloseAction(function<void(TDirectory *)> action) { fCloseAction = action; }
+
+  Double_t GetWaitTime() const { return fWaitTime; }   ///< time producers spent waiting for a free slot [s]
+  Double_t GetWriteTime() const { return fWriteTime; } ///< time the writer spent in TTree::Fill [s]
+  Long64_t GetNumWrittenEvents() const { return fNumWrittenEvents; }
+
+private:
+  enum SlotState
+  {
+    kSlotFree,
+    kSlotQueued,
+    kSlotSkipped,
+  };
+
+  struct Slot
+  {
+    Long64_t fEvent = -1;
+    SlotState fState = kSlotFree;
+    vector<TClonesArray *> fArrays;
+  };
+
+  void WriteLoop();
+  Slot &AcquireSlot(Long64_t event, unique_lock<mutex> &lock);
+  void DeleteSlots();
+
+  vector<LHEventBranch> fBranches;
+  TFile *fFile = nullptr;
+  TTree *fTree = nullptr;
+  vector<TBranch *> fTreeBranches;
+  vector<TClonesArray *> fFillArrays; ///< addresses given to fTreeBranches, pointing to the slot arrays
+
+  vector<Slot> fSlots;
+  Long64_t fNextEvent = 0;
+  Long64_t fNumWrittenEvents = 0;
+  bool fClose = false;
+  mutex fMutex;
+  condition_variable fSlotFreed;
+  condition_variable fSlotQueued;
+  thread fThread;
+  function<void(TDirectory *)> fCloseAction;
+
+  Double_t fWaitTime = 0;
+  Double_t fWriteTime = 0;
+};
+
+/**
+ * Event loop replacing KBRun::Run with asynchronous input and output.
+ *
+ * KBRun reads and writes no file in this mode (set neither SetIOFile nor
+ * SetOutputFile). Init registers the input branches as non-persistent KBRun
+ * branches so the tasks find them with GetBranch, and LHEventPrefetcher reads
+ * event N+1 while the task chain processes event N. The event ID of the tasks
+ * is given through LHRunContext::SetEventID. The output branches are copied
+ * after each event and written by LHEventWriter on its own thread; objects
+ * other than the tree go to the output file through SetEndOfRunAction.
+ *
+ *   auto loop = new LHAsyncEventLoop();
+ *   loop->SetInputFile("out_LH.mc");
+ *   loop->AddInputBranch<KBMCStep>("MCStep10");
+ *   loop->SetOutputFile("out_LH.async.root");
+ *   loop->AddOutputBranch<KBHelixTrack>("Tracklet");
+ *   loop->Init();
+ *   run->Init();
+ *   loop->SetEndOfRunAction([htfTask](TDirectory *file) { htfTask->WriteStepHistograms(file); });
+ *   loop->Run();
+ */
+class LHAsyncEventLoop
+{
+public:
+  LHAsyncEventLoop() {}
+  /// Deletes the input arrays registered in KBRun, so delete the loop after the run
+  virtual ~LHAsyncEventLoop();
+
+  void SetInputFile(TString fileName, TString treeName = "event")
+  {
+    fInputFileName = fileName;
+    fInputTreeName = treeName;
+  }
+  void SetOutputFile(TString fileName, TString treeName = "event")
+  {
+    fOutputFileName = fileName;
+    fOutputTreeName = treeName;
+  }
+
+  template <class T>
+  void AddInputBranch(TString name) { fPrefetcher.AddBranch<T>(name); }
+  template <class T>
+  void AddOutputBranch(TString name) { fWriter.AddBranch<T>(name); }
+
+  /// Called with the output file after the last event is written, e.g. to write histograms of the tasks
+  void SetEndOfRunAction(function<void(TDirectory *)> action) { fWriter.SetCloseAction(action); }
+
+  void SetNumPrefetchEvents(Int_t val) { fNumPrefetchEvents = val; }
+  void SetNumOutputEvents(Int_t val) { fNumOutputEvents = val; }
+
+  /// Open the input and register the input branches, before KBRun::Init
+  bool Init();
+  /// Process numEvents (all input entries if negative), after KBRun::Init
+  void Run(Long64_t numEvents = -1);
+
+  Double_t GetRealTime() const { return fRealTime; }
+
+private:
+  TString fInputFileName;
+  TString fInputTreeName = "event";
+  TString fOutputFileName;
+  TString fOutputTreeName = "event";
+
+  Int_t fNumPrefetchEvents = 2;
+  Int_t fNumOutputEvents = 4;
+
+  LHEventPrefetcher fPrefetcher;
+  LHEventWriter fWriter;
+  vector<TClonesArray *> fInputArrays;
+  vector<TClonesArray *> fOutputArrays;
+
+  Double_t fRealTime = 0;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "LHCandidateHeap.hh"
+
+void LHCandidateHeap::OrderByCharge(bool sortEarlierIfSmaller)
+{
+  // the last hit after an ascending sort is the largest
+  Double_t sign = sortEarlierIfSmaller ? 1 : -1;
+  if (fOrderType != kOrderCharge || fSign != sign)
+    fPriorities.clear();
+  fOrderType = kOrderCharge;
+  fSign = sign;
+}
+
+void LHCandidateHeap::OrderByDistanceTo(TVector3 point, bool sortEarlierIfCloser)
+{
+  fPriorities.clear();
+  fOrderType = kOrderDistance;
+  fSign = sortEarlierIfCloser ? 1 : -1;
+  fPoint = point;
+}
+
+Double_t LHCandidateHeap::Priority(KBHit *hit) const
+{
+  if (fOrderType == kOrderCharge)
+    return fSign * hit->GetCharge();
+  if (fOrderType == kOrderDistance)
+    return fSign * (hit->GetPosition() - fPoint).Mag2();
+  return 0;
+}
+
+void LHCandidateHeap::Build(KBHitArray *hitArray)
+{
+  Int_t numHits = hitArray->GetNumHits();
+  fPriorities.resize(numHits);
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+    fPriorities[iHit] = Priority(hitArray->GetHit(iHit));
+
+  for (Int_t iHit = numHits / 2 - 1; iHit >= 0; --iHit)
+    SiftDown(hitArray, iHit, numHits);
+}
+
+void LHCandidateHeap::Update(KBHitArray *hitArray)
+{
+  Int_t numHits = hitArray->GetNumHits();
+  Int_t numHeapHits = fPriorities.size();
+  if (numHits < numHeapHits)
+  {
+    Build(hitArray);
+    return;
+  }
+
+  for (Int_t iHit = numHeapHits; iHit < numHits; ++iHit)
+  {
+    fPriorities.push_back(Priority(hitArray->GetHit(iHit)));
+    SiftUp(hitArray, iHit);
+  }
+}
+
+KBTpcHit *LHCandidateHeap::PopHit(KBHitArray *hitArray)
+{
+  Int_t numHits = hitArray->GetNumHits();
+  if (numHits == 0)
+    return nullptr;
+  if (Int_t(fPriorities.size()) != numHits)
+    Build(hitArray);
+
+  Swap(hitArray, 0, numHits - 1);
+  SiftDown(hitArray, 0, numHits - 1);
+
+  auto hit = (KBTpcHit *)hitArray->GetLastHit();
+  hitArray->RemoveLastHit();
+  fPriorities.pop_back();
+  return hit;
+}
+
+void LHCandidateHeap::Swap(KBHitArray *hitArray, Int_t i, Int_t j)
+{
+  if (i == j)
+    return;
+  auto hit = hitArray->GetHit(i);
+  hitArray->AddAt(hitArray->GetHit(j), i);
+  hitArray->AddAt(hit, j);
+  swap(fPriorities[i], fPriorities[j]);
+}
+
+void LHCandidateHeap::SiftUp(KBHitArray *hitArray, Int_t i)
+{
+  while (i > 0)
+  {
+    Int_t parent = (i - 1) / 2;
+    if (fPriorities[parent] >= fPriorities[i])
+      break;
+    Swap(hitArray, parent, i);
+    i = parent;
+  }
+}
+
+void LHCandidateHeap::SiftDown(KBHitArray *hitArray, Int_t i, Int_t size)
+{
+  while (true)
+  {
+    Int_t largest = i;
+    Int_t left = 2 * i + 1;
+    Int_t right = left + 1;
+    if (left < size && fPriorities[left] > fPriorities[largest])
+      largest = left;
+    if (right < size && fPriorities[right] > fPriorities[largest])
+      largest = right;
+    if (largest == i)
+      return;
+    Swap(hitArray, i, largest);
+    i = largest;
+  }
+}
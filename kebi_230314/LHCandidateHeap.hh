@@ -0,0 +1,59 @@
+#ifndef LHCANDIDATEHEAP_HH
+#define LHCANDIDATEHEAP_HH
+
+#include "TVector3.h"
+
+#include "KBHitArray.hh"
+#include "KBTpcHit.hh"
+
+#include <vector>
+using namespace std;
+
+/**
+ * Binary heap kept in place inside a KBHitArray of candidate hits.
+ *
+ * PopHit returns the hit which GetLastHit would return after
+ * KBHitArray::SortByCharge or SortByDistanceTo with the same flag, without
+ * sorting the whole array: Build orders the array in O(n), hits appended to
+ * the array afterwards are merged with Update in O(log n) each, and every pop
+ * costs O(log n). The keys are cached next to the array, so Build has to be
+ * called again after the array is changed other than by appending or PopHit.
+ * Changing the order drops the cached keys; the next Update then adds all hits.
+ */
+class LHCandidateHeap
+{
+public:
+  LHCandidateHeap() {}
+  virtual ~LHCandidateHeap() {}
+
+  void OrderByCharge(bool sortEarlierIfSmaller);
+  void OrderByDistanceTo(TVector3 point, bool sortEarlierIfCloser);
+
+  /// Heapify all hits of hitArray with the current order
+  void Build(KBHitArray *hitArray);
+  /// Add the hits appended to hitArray since the last Build, Update or PopHit
+  void Update(KBHitArray *hitArray);
+  /// Remove the top hit from the end of hitArray and return it
+  KBTpcHit *PopHit(KBHitArray *hitArray);
+
+private:
+  enum OrderType
+  {
+    kOrderNone,
+    kOrderCharge,
+    kOrderDistance,
+  };
+
+  Double_t Priority(KBHit *hit) const;
+  void Swap(KBHitArray *hitArray, Int_t i, Int_t j);
+  void SiftUp(KBHitArray *hitArray, Int_t i);
+  void SiftDown(KBHitArray *hitArray, Int_t i, Int_t size);
+
+  OrderType fOrderType = kOrderNone;
+  Double_t fSign = 1; ///< PopHit takes the largest fSign * key
+  TVector3 fPoint;
+
+  vector<Double_t> fPriorities; ///< priority of the hit at the same index of the array
+};
+
+#endif
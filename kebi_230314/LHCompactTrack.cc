@@ -0,0 +1,203 @@
+#include "LHCompactTrack.hh"
+
+#include "TMath.h"
+#include "TVector2.h"
+
+#include <algorithm>
+#include <cmath>
+
+ClassImp(LHCompactTrack)
+
+void LHCompactTrack::Clear(Option_t *)
+{
+  fTrackID = -1;
+  fI = fJ = fR = fS = fK = 0;
+  fAlphaRef = fAlphaMin = fAlphaMax = 0;
+  for (auto &cov : fCov)
+    cov = 0;
+  fRMSR = fRMSK = 0;
+  fNumHits = 0;
+  fNumHits_FT = 0;
+  fPackedHits.clear();
+  fPackedHits_FT.clear();
+}
+
+void LHCompactTrack::Fill(KBHelixTrack *track, TClonesArray *hitArray, KBVector3::Axis referenceAxis)
+{
+  Clear();
+
+  fTrackID = track->GetTrackID();
+  Double_t ci = track->GetHelixCenterI();
+  Double_t cj = track->GetHelixCenterJ();
+  Double_t radius = track->GetHelixRadius();
+  fI = ci;
+  fJ = cj;
+  fR = radius;
+
+  std::vector<Int_t> indices;
+  std::vector<Double_t> alphas, ks;
+  Double_t sumR2 = 0;
+  Double_t ti = 0, tj = 0; // sum of hit directions from the center, to get a reference angle inside the track
+  auto trackHits = track->GetHitArray();
+  Int_t numHits = trackHits->GetNumHits();
+  Int_t numBranchHits = hitArray->GetEntriesFast();
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+  {
+    auto hit = trackHits->GetHit(iHit);
+    // the hit ID is the branch index unless an earlier task reordered or removed hits
+    Int_t index = hit->GetHitID();
+    if (index < 0 || index >= numBranchHits || hitArray->UncheckedAt(index) != hit)
+      index = hitArray->IndexOf(hit);
+    indices.push_back(index);
+
+    KBVector3 qos(hit->GetPosition(), referenceAxis);
+    Double_t di = qos.I() - ci, dj = qos.J() - cj;
+    Double_t d = sqrt(di * di + dj * dj);
+    sumR2 += (d - radius) * (d - radius);
+    if (d > 0)
+    {
+      ti += di / d;
+      tj += dj / d;
+    }
+    alphas.push_back(atan2(dj, di));
+    ks.push_back(qos.K());
+  }
+
+  fNumHits = indices.size();
+  Pack(indices, fPackedHits);
+
+  Int_t n = alphas.size();
+  if (n < 3 || !(radius > 0))
+    return;
+
+  // geometric circle fit linearized at the track helix : d(residual)/d(i, j, R) = (-cos, -sin, -1)
+  Double_t a[3][3] = {{0}};
+  fAlphaRef = atan2(tj, ti);
+  Double_t alphaMin = 0, alphaMax = 0;
+  Double_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (Int_t iHit = 0; iHit < n; ++iHit)
+  {
+    Double_t c = cos(alphas[iHit]), s = sin(alphas[iHit]);
+    Double_t row[3] = {-c, -s, -1.};
+    for (Int_t r = 0; r < 3; ++r)
+      for (Int_t q = 0; q < 3; ++q)
+        a[r][q] += row[r] * row[q];
+
+    Double_t dAlpha = TVector2::Phi_mpi_pi(alphas[iHit] - fAlphaRef);
+    alphaMin = std::min(alphaMin, dAlpha);
+    alphaMax = std::max(alphaMax, dAlpha);
+    sx += dAlpha;
+    sy += ks[iHit];
+    sxx += dAlpha * dAlpha;
+    sxy += dAlpha * ks[iHit];
+  }
+  fAlphaMin = fAlphaRef + alphaMin;
+  fAlphaMax = fAlphaRef + alphaMax;
+
+  // k = fK + fS * (alpha - fAlphaRef)
+  Double_t det = n * sxx - sx * sx;
+  if (det <= 0)
+    return;
+  fS = (n * sxy - sx * sy) / det;
+  fK = (sy * sxx - sx * sxy) / det;
+
+  Double_t sumK2 = 0;
+  for (Int_t iHit = 0; iHit < n; ++iHit)
+  {
+    Double_t dAlpha = TVector2::Phi_mpi_pi(alphas[iHit] - fAlphaRef);
+    sumK2 += pow(ks[iHit] - fK - fS * dAlpha, 2);
+  }
+  fRMSK = sqrt(sumK2 / n);
+  fRMSR = sqrt(sumR2 / n);
+
+  // circle block : sigma^2 (A^T A)^-1 with sigma^2 from the residuals
+  Double_t sigma2R = n > 3 ? sumR2 / (n - 3) : sumR2;
+  Double_t c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+  Double_t c01 = a[0][2] * a[2][1] - a[0][1] * a[2][2];
+  Double_t c02 = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+  Double_t detA = a[0][0] * c00 + a[1][0] * c01 + a[2][0] * c02;
+  if (detA != 0)
+  {
+    Double_t inv[3][3];
+    inv[0][0] = c00 / detA;
+    inv[0][1] = c01 / detA;
+    inv[0][2] = c02 / detA;
+    inv[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) / detA;
+    inv[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) / detA;
+    inv[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) / detA;
+    fCov[0] = sigma2R * inv[0][0];
+    fCov[1] = sigma2R * inv[0][1];
+    fCov[2] = sigma2R * inv[1][1];
+    fCov[3] = sigma2R * inv[0][2];
+    fCov[4] = sigma2R * inv[1][2];
+    fCov[5] = sigma2R * inv[2][2];
+  }
+
+  // line block : sigma^2 [[n, -sx], [-sx, sxx]] / det for (fS, fK)
+  Double_t sigma2K = n > 2 ? sumK2 / (n - 2) : sumK2;
+  fCov[9] = sigma2K * n / det;     // (S, S)
+  fCov[13] = -sigma2K * sx / det;  // (K, S)
+  fCov[14] = sigma2K * sxx / det;  // (K, K)
+}
+
+void LHCompactTrack::SetHitIndices_FT(std::vector<Int_t> &indices)
+{
+  fNumHits_FT = indices.size();
+  Pack(indices, fPackedHits_FT);
+}
+
+void LHCompactTrack::Rebuild(KBHelixTrack *track, TClonesArray *hitArray) const
+{
+  track->Clear();
+  track->SetTrackID(fTrackID);
+
+  std::vector<Int_t> indices;
+  GetHitIndices(indices);
+  for (auto index : indices)
+    track->AddHit((KBHit *)hitArray->At(index));
+
+  track->Fit();
+}
+
+void LHCompactTrack::Pack(std::vector<Int_t> &indices, std::vector<UChar_t> &packed)
+{
+  sort(indices.begin(), indices.end());
+
+  packed.clear();
+  Int_t previous = 0;
+  for (auto index : indices)
+  {
+    UInt_t delta = index - previous;
+    previous = index;
+    do
+    {
+      UChar_t byte = delta & 0x7f;
+      delta >>= 7;
+      if (delta != 0)
+        byte |= 0x80;
+      packed.push_back(byte);
+    } while (delta != 0);
+  }
+}
+
+void LHCompactTrack::Unpack(const std::vector<UChar_t> &packed, Int_t numIndices, std::vector<Int_t> &indices)
+{
+  indices.clear();
+  indices.reserve(numIndices);
+
+  Int_t previous = 0;
+  UInt_t delta = 0;
+  Int_t shift = 0;
+  for (auto byte : packed)
+  {
+    delta |= UInt_t(byte & 0x7f) << shift;
+    shift += 7;
+    if (byte & 0x80)
+      continue;
+
+    previous += delta;
+    indices.push_back(previous);
+    delta = 0;
+    shift = 0;
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef LHCOMPACTTRACK_HH
+#define LHCOMPACTTRACK_HH
+
+#include "TObject.h"
+#include "TClonesArray.h"
+
+#include "KBHelixTrack.hh"
+#include "KBVector3.hh"
+
+#include <vector>
+
+/**
+ * Compact persistency of a KBHelixTrack (see LHHelixTrackFindingTask::SetCompactTrackletPersistency).
+ *
+ * Helix in the LHTF_refAxis frame : i = fI + fR cos(alpha), j = fJ + fR sin(alpha),
+ * k = fK + fS (alpha - fAlphaRef), valid for alpha in [fAlphaMin, fAlphaMax].
+ * The covariance of (fI, fJ, fR, fS, fK) is the packed lower triangle of the
+ * geometric circle fit and of the k(alpha) line fit (the two blocks are
+ * uncorrelated). Hits are stored as sorted indices into the TPC and FT hit
+ * branches, delta encoded as LEB128 varints; the FT indices are those of the
+ * FT matches of the track (LHFTAssociation). Rebuild makes the full track again.
+ */
+class LHCompactTrack : public TObject
+{
+public:
+  LHCompactTrack() { Clear(); }
+  virtual ~LHCompactTrack() {}
+
+  virtual void Clear(Option_t *option = "");
+
+  /// Fill the helix, its covariance, fit quality and the indices of the track hits in hitArray (the TPC hit branch)
+  void Fill(KBHelixTrack *track, TClonesArray *hitArray, KBVector3::Axis referenceAxis);
+  /// Indices of the FT hits matched to the track in the FT hit branch
+  void SetHitIndices_FT(std::vector<Int_t> &indices);
+  /// Clear track, add the TPC hits of this compact track from the hit branch and refit it
+  void Rebuild(KBHelixTrack *track, TClonesArray *hitArray) const;
+
+  Int_t GetTrackID() const { return fTrackID; }
+  Double_t GetHelixCenterI() const { return fI; }
+  Double_t GetHelixCenterJ() const { return fJ; }
+  Double_t GetHelixRadius() const { return fR; }
+  Double_t GetAlphaSlope() const { return fS; } ///< dk / dalpha
+  Double_t GetK() const { return fK; }          ///< k at fAlphaRef
+  Double_t GetAlphaRef() const { return fAlphaRef; }
+  Double_t GetAlphaMin() const { return fAlphaMin; }
+  Double_t GetAlphaMax() const { return fAlphaMax; }
+  Double_t GetCovariance(Int_t i, Int_t j) const { return fCov[i >= j ? i * (i + 1) / 2 + j : j * (j + 1) / 2 + i]; }
+  Double_t GetRMSR() const { return fRMSR; } ///< rms of the circle residuals
+  Double_t GetRMSK() const { return fRMSK; } ///< rms of the k(alpha) residuals
+  Int_t GetNumHits() const { return fNumHits; }
+  Int_t GetNumHits_FT() const { return fNumHits_FT; }
+
+  void GetHitIndices(std::vector<Int_t> &indices) const { Unpack(fPackedHits, fNumHits, indices); }
+  void GetHitIndices_FT(std::vector<Int_t> &indices) const { Unpack(fPackedHits_FT, fNumHits_FT, indices); }
+
+private:
+  static void Pack(std::vector<Int_t> &indices, std::vector<UChar_t> &packed);
+  static void Unpack(const std::vector<UChar_t> &packed, Int_t numIndices, std::vector<Int_t> &indices);
+
+  Int_t fTrackID;
+  Float_t fI, fJ, fR, fS, fK;
+  Float_t fAlphaRef, fAlphaMin, fAlphaMax;
+  Float_t fCov[15];
+  Float_t fRMSR, fRMSK;
+  Int_t fNumHits;
+  Int_t fNumHits_FT;
+  std::vector<UChar_t> fPackedHits;
+  std::vector<UChar_t> fPackedHits_FT;
+
+  ClassDef(LHCompactTrack, 1)
+};
+
+#endif
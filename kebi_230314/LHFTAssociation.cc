@@ -0,0 +1,12 @@
+#include "LHFTAssociation.hh"
+
+ClassImp(LHFTAssociation)
+
+void LHFTAssociation::Clear(Option_t *)
+{
+  fTrackID = -1;
+  fHitIndex = -1;
+  fPlane = -1;
+  fChi2 = 0;
+  fLength = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef LHFTASSOCIATION_HH
+#define LHFTASSOCIATION_HH
+
+#include "TObject.h"
+
+/**
+ * FT hit attached to a track by LHFTTrackMatcher, persisted in the FT match
+ * branch of LHHelixTrackFindingTask (see SetFTMatchBranchName). FT hits stay
+ * out of the TPC hit array of the track; both sides are referred to by their
+ * index in the Tracklet and FT hit branches. Entries are sorted by track.
+ */
+class LHFTAssociation : public TObject
+{
+public:
+  LHFTAssociation() { Clear(); }
+  virtual ~LHFTAssociation() {}
+
+  virtual void Clear(Option_t *option = "");
+
+  void SetTrackID(Int_t id) { fTrackID = id; }
+  void SetHitIndex(Int_t index) { fHitIndex = index; }
+  void SetPlane(Int_t plane) { fPlane = plane; }
+  void SetChi2(Double_t val) { fChi2 = val; }
+  void SetLength(Double_t val) { fLength = val; }
+
+  Int_t GetTrackID() const { return fTrackID; }   ///< index of the track in the Tracklet branch
+  Int_t GetHitIndex() const { return fHitIndex; } ///< index of the hit in the FT hit branch
+  Int_t GetPlane() const { return fPlane; }
+  Double_t GetChi2() const { return fChi2; }
+  Double_t GetLength() const { return fLength; } ///< extrapolation length from the track end [mm]
+
+private:
+  Int_t fTrackID;
+  Int_t fHitIndex;
+  Int_t fPlane;
+  Double_t fChi2;
+  Double_t fLength;
+
+  ClassDef(LHFTAssociation, 1)
+};
+
+#endif
@@ -1,9 +1,12 @@
 #include "LHFTHitTask.hh"
 #include "FTHit.hh"
 #include "KBRun.hh"
+#include "LHRunContext.hh"
+#include "LHAllocationCounter.hh"
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
 #include <TH3D.h>
 using namespace std;
 
@@ -18,25 +21,23 @@ LHFTHitTask::~LHFTHitTask()
 
 bool LHFTHitTask::Init()
 {
-	KBRun *run = KBRun::GetRun();
-
-	fMCStepArray = (TClonesArray *)run->GetBranch(Form("MCStep%d", fDetID));
+	fMCStepArray = (TClonesArray *)LHRunContext::GetBranch(Form("MCStep%d", fDetID));
 	fStepArray = new TClonesArray("KBMCStep");
-	run->RegisterBranch("FTStep", fStepArray, fPersistency);
+	LHRunContext::RegisterBranch("FTStep", fStepArray, fPersistency);
 
 	fFTHitArray = new TClonesArray("FTHit");
-	run->RegisterBranch("FTHit", fFTHitArray, fPersistency);
+	LHRunContext::RegisterBranch("FTHit", fFTHitArray, fPersistency);
 
 	return true;
 }
 
 void LHFTHitTask::Exec(Option_t *)
 {
-	fStepArray -> Delete();
-	fFTHitArray-> Delete();
-	
-	fStepArray -> Clear();
-	fFTHitArray-> Clear();
+	Long64_t numAllocationsAtStart = LHAllocationCounter::GetCount();
+
+	// Clear("C") keeps the KBMCStep and FTHit objects of earlier events; ConstructedAt reuses them below
+	fStepArray -> Clear("C");
+	fFTHitArray-> Clear("C");
 	
 	Long64_t nMCSteps = fMCStepArray->GetEntries();
 
@@ -54,7 +55,7 @@ void LHFTHitTask::Exec(Option_t *)
 		double FT_step_trackID = step->GetTrackID();
 		double FT_step_copyNo = step->GetcopyNo();
 
-		KBMCStep * SingleStep = new ((*fStepArray)[iStep]) KBMCStep();
+		KBMCStep * SingleStep = (KBMCStep *)fStepArray->ConstructedAt(iStep);
 		SingleStep->SetMCStep(FT_step_trackID, FT_step_moduleID, FT_step_x, FT_step_y, FT_step_z, FT_step_time, FT_step_edep);
 		
 		// if(FT_step_trackID != 1)
@@ -76,6 +77,98 @@ void LHFTHitTask::Exec(Option_t *)
 
 		}
 	}
+
+	if (!RAWSTEP)
+		MakeClusters();
+
+	kb_info << " Number of FT hits : " << fFTHitArray->GetEntriesFast() << endl;
+
+	if (LHAllocationCounter::IsEnabled())
+	{
+		fNumAllocationsInEvent = LHAllocationCounter::GetCount() - numAllocationsAtStart;
+		kb_info << " Heap allocations in event : " << fNumAllocationsInEvent << endl;
+	}
+}
+
+void LHFTHitTask::MakeClusters()
+{
+	// Steps are grouped by module and merged when they lie within fClusterDistance
+	// of any step already in the cluster. Each cluster becomes one FTHit at the
+	// energy-weighted mean position with the summed energy deposit as its charge.
+	int nSteps = fStepArray->GetEntriesFast();
+
+	fStepOrder.resize(nSteps);
+	for (int iStep = 0; iStep < nSteps; iStep++)
+		fStepOrder[iStep] = iStep;
+	std::stable_sort(fStepOrder.begin(), fStepOrder.end(), [this](int a, int b)
+	{
+		return ((KBMCStep *)fStepArray->At(a))->GetModuleID() < ((KBMCStep *)fStepArray->At(b))->GetModuleID();
+	});
+
+	fStepIsClustered.assign(nSteps, false);
+	double distance2 = fClusterDistance * fClusterDistance;
+
+	int iModuleBegin = 0;
+	while (iModuleBegin < nSteps)
+	{
+		int moduleID = ((KBMCStep *)fStepArray->At(fStepOrder[iModuleBegin]))->GetModuleID();
+		int iModuleEnd = iModuleBegin;
+		while (iModuleEnd < nSteps && ((KBMCStep *)fStepArray->At(fStepOrder[iModuleEnd]))->GetModuleID() == moduleID)
+			iModuleEnd++;
+
+		for (int iSeed = iModuleBegin; iSeed < iModuleEnd; iSeed++)
+		{
+			if (fStepIsClustered[fStepOrder[iSeed]])
+				continue;
+
+			fClusterSteps.clear();
+			fClusterSteps.push_back(fStepOrder[iSeed]);
+			fStepIsClustered[fStepOrder[iSeed]] = true;
+
+			for (int iMember = 0; iMember < (int)fClusterSteps.size(); iMember++)
+			{
+				KBMCStep *member = (KBMCStep *)fStepArray->At(fClusterSteps[iMember]);
+				for (int iCand = iSeed + 1; iCand < iModuleEnd; iCand++)
+				{
+					int candStep = fStepOrder[iCand];
+					if (fStepIsClustered[candStep])
+						continue;
+
+					KBMCStep *cand = (KBMCStep *)fStepArray->At(candStep);
+					double dx = cand->GetX() - member->GetX();
+					double dy = cand->GetY() - member->GetY();
+					double dz = cand->GetZ() - member->GetZ();
+					if (dx * dx + dy * dy + dz * dz > distance2)
+						continue;
+
+					fClusterSteps.push_back(candStep);
+					fStepIsClustered[candStep] = true;
+				}
+			}
+
+			double edep = 0, x = 0, y = 0, z = 0;
+			for (int stepIndex : fClusterSteps)
+			{
+				KBMCStep *step = (KBMCStep *)fStepArray->At(stepIndex);
+				double w = step->GetEdep();
+				edep += w;
+				x += w * step->GetX();
+				y += w * step->GetY();
+				z += w * step->GetZ();
+			}
+
+			if (edep <= 0 || edep < fEdepThreshold)
+				continue;
+
+			int iHit = fFTHitArray->GetEntriesFast();
+			FTHit *cluster = (FTHit *)fFTHitArray->ConstructedAt(iHit);
+			cluster->SetFTHit(moduleID, x / edep, y / edep, z / edep);
+			cluster->SetHitID(40000 + iHit);
+			cluster->SetCharge(edep);
+		}
+
+		iModuleBegin = iModuleEnd;
+	}
 }
 
 void LHFTHitTask::SetDetID(int id)
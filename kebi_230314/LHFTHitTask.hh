@@ -2,6 +2,7 @@
 #include "TClonesArray.h"
 
 #include <TH3D.h>
+#include <vector>
 
 class LHFTHitTask : public KBTask
 {
@@ -15,6 +16,15 @@ public:
 	void SetPersistency(bool val);
 	void SetDetID(int id);
 
+	/// Steps of one module closer than val [mm] to a step of a cluster are merged into it
+	void SetClusterDistance(double val) { fClusterDistance = val; }
+	/// Clusters with a summed energy deposit below val are not written
+	void SetEdepThreshold(double val) { fEdepThreshold = val; }
+	/// true : one FTHit per Geant4 step (previous behavior), false : clustered hits
+	void SetRawStepMode(bool val) { RAWSTEP = val; }
+
+	Long64_t GetNumAllocationsInEvent() const { return fNumAllocationsInEvent; }
+
 private:
 	TClonesArray *fMCStepArray;
 	TClonesArray *fStepArray;
@@ -22,10 +32,21 @@ private:
 	TClonesArray *fFTHit;
 
 	bool RECONSTRUCTION = false;
-	bool RAWSTEP = true;
+	bool RAWSTEP = false;
+
+	void MakeClusters();
+
+	double fClusterDistance = 1.;
+	double fEdepThreshold = 0.;
+
+	std::vector<int> fStepOrder;        // step indices sorted by module ID
+	std::vector<int> fClusterSteps;     // steps of the cluster being built
+	std::vector<bool> fStepIsClustered;
 
 	bool fPersistency = true;
 	int fDetID = 40;
 	int layerN;
 
+	Long64_t fNumAllocationsInEvent = -1;
+
 };
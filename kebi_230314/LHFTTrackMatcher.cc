@@ -0,0 +1,179 @@
+#include "LHFTTrackMatcher.hh"
+
+#include <algorithm>
+#include <cmath>
+
+void LHFTTrackMatcher::SetHits(TClonesArray *ftHitArray)
+{
+  fPoints.clear();
+  for (auto &plane : fPlanes)
+    plane.fTree.clear();
+
+  Int_t numHits = ftHitArray == nullptr ? 0 : ftHitArray->GetEntriesFast();
+  fNumHits = numHits;
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+  {
+    auto hit = (FTHit *)ftHitArray->At(iHit);
+    KBVector3 qos(hit->GetPosition(), fReferenceAxis);
+    FTPoint point;
+    point.fIJ[0] = qos.I();
+    point.fIJ[1] = qos.J();
+    point.fK = qos.K();
+    point.fHit = hit;
+    point.fIndex = iHit;
+    fPoints.push_back(point);
+  }
+
+  sort(fPoints.begin(), fPoints.end(), [](const FTPoint &a, const FTPoint &b)
+       { return a.fK < b.fK; });
+
+  // a new plane starts wherever two consecutive hits are further apart than fPlaneGap along k
+  Int_t numPlanes = 0;
+  Int_t numPoints = fPoints.size();
+  for (Int_t iPoint = 0; iPoint < numPoints; ++iPoint)
+  {
+    if (iPoint == 0 || fPoints[iPoint].fK - fPoints[iPoint - 1].fK > fPlaneGap)
+    {
+      if (Int_t(fPlanes.size()) <= numPlanes)
+        fPlanes.push_back(FTPlane());
+      fPlanes[numPlanes].fK = 0;
+      ++numPlanes;
+    }
+    fPlanes[numPlanes - 1].fTree.push_back(fPoints[iPoint]);
+  }
+  fPlanes.resize(numPlanes);
+
+  for (auto &plane : fPlanes)
+  {
+    for (auto &point : plane.fTree)
+      plane.fK += point.fK;
+    plane.fK /= plane.fTree.size();
+    BuildTree(plane.fTree, 0, plane.fTree.size(), 0);
+  }
+}
+
+void LHFTTrackMatcher::BuildTree(vector<FTPoint> &tree, Int_t begin, Int_t end, Int_t axis)
+{
+  if (end - begin <= 1)
+    return;
+
+  Int_t mid = (begin + end) / 2;
+  nth_element(tree.begin() + begin, tree.begin() + mid, tree.begin() + end, [axis](const FTPoint &a, const FTPoint &b)
+              { return a.fIJ[axis] < b.fIJ[axis]; });
+
+  BuildTree(tree, begin, mid, 1 - axis);
+  BuildTree(tree, mid + 1, end, 1 - axis);
+}
+
+void LHFTTrackMatcher::SearchTree(const vector<FTPoint> &tree, Int_t begin, Int_t end, Int_t axis, const Double_t *ij, Double_t range2) const
+{
+  if (end <= begin)
+    return;
+
+  Int_t mid = (begin + end) / 2;
+  const FTPoint &point = tree[mid];
+
+  Double_t di = point.fIJ[0] - ij[0];
+  Double_t dj = point.fIJ[1] - ij[1];
+  if (di * di + dj * dj <= range2)
+    fFound.push_back(&point);
+
+  Double_t dAxis = ij[axis] - point.fIJ[axis];
+  if (dAxis <= 0 || dAxis * dAxis <= range2)
+    SearchTree(tree, begin, mid, 1 - axis, ij, range2);
+  if (dAxis >= 0 || dAxis * dAxis <= range2)
+    SearchTree(tree, mid + 1, end, 1 - axis, ij, range2);
+}
+
+bool LHFTTrackMatcher::ExtrapolateToPlane(KBHelixTrack *track, Double_t k, TVector3 &position, Double_t &length) const
+{
+  // k is linear in the travel length along a helix, so one probe step per end gives the exact length
+  Double_t kHead = KBVector3(track->PositionAtHead(), fReferenceAxis).K();
+  Double_t kTail = KBVector3(track->PositionAtTail(), fReferenceAxis).K();
+  Double_t dkHead = KBVector3(track->ExtrapolateHead(fProbeLength), fReferenceAxis).K() - kHead;
+  Double_t dkTail = KBVector3(track->ExtrapolateTail(fProbeLength), fReferenceAxis).K() - kTail;
+
+  Double_t lengthHead = -1, lengthTail = -1;
+  if (abs(dkHead) > 1.e-6)
+    lengthHead = (k - kHead) * fProbeLength / dkHead;
+  if (abs(dkTail) > 1.e-6)
+    lengthTail = (k - kTail) * fProbeLength / dkTail;
+
+  bool useHead = lengthHead >= 0 && (lengthTail < 0 || lengthHead <= lengthTail);
+  length = useHead ? lengthHead : lengthTail;
+  if (length < 0 || length > fMaxExtrapolationLength)
+    return false;
+
+  position = useHead ? track->ExtrapolateHead(length) : track->ExtrapolateTail(length);
+  return true;
+}
+
+void LHFTTrackMatcher::MatchTracks(TClonesArray *trackArray, vector<LHFTMatch> &matches)
+{
+  matches.clear();
+  fCandidates.clear();
+
+  Int_t numPlanes = fPlanes.size();
+  Int_t numTracks = trackArray->GetEntriesFast();
+  if (numPlanes == 0 || numTracks == 0)
+    return;
+
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    auto track = (KBHelixTrack *)trackArray->At(iTrack);
+    if (track == nullptr || !track->IsHelix())
+      continue;
+
+    for (Int_t iPlane = 0; iPlane < numPlanes; ++iPlane)
+    {
+      TVector3 position;
+      Double_t length;
+      if (!ExtrapolateToPlane(track, fPlanes[iPlane].fK, position, length))
+        continue;
+
+      KBVector3 qos(position, fReferenceAxis);
+      Double_t ij[2] = {qos.I(), qos.J()};
+      Double_t sigma2 = fHitResolution * fHitResolution + pow(fExtrapolationError * length, 2);
+
+      fFound.clear();
+      SearchTree(fPlanes[iPlane].fTree, 0, fPlanes[iPlane].fTree.size(), 0, ij, fCutChi2 * sigma2);
+
+      for (auto point : fFound)
+      {
+        LHFTMatch candidate;
+        candidate.fTrackIndex = iTrack;
+        candidate.fPlane = iPlane;
+        candidate.fHit = point->fHit;
+        candidate.fHitIndex = point->fIndex;
+        candidate.fChi2 = (pow(point->fIJ[0] - ij[0], 2) + pow(point->fIJ[1] - ij[1], 2)) / sigma2;
+        candidate.fLength = length;
+        fCandidates.push_back(candidate);
+      }
+    }
+  }
+
+  sort(fCandidates.begin(), fCandidates.end(), [](const LHFTMatch &a, const LHFTMatch &b)
+       {
+         if (a.fChi2 != b.fChi2)
+           return a.fChi2 < b.fChi2;
+         if (a.fTrackIndex != b.fTrackIndex)
+           return a.fTrackIndex < b.fTrackIndex;
+         return a.fHitIndex < b.fHitIndex;
+       });
+
+  fHitIsUsed.assign(fNumHits, false);
+  fTrackPlaneIsUsed.assign(numTracks * numPlanes, false);
+  for (auto &candidate : fCandidates)
+  {
+    Int_t trackPlane = candidate.fTrackIndex * numPlanes + candidate.fPlane;
+    if (fTrackPlaneIsUsed[trackPlane] || fHitIsUsed[candidate.fHitIndex])
+      continue;
+
+    fTrackPlaneIsUsed[trackPlane] = true;
+    fHitIsUsed[candidate.fHitIndex] = true;
+    matches.push_back(candidate);
+  }
+
+  stable_sort(matches.begin(), matches.end(), [](const LHFTMatch &a, const LHFTMatch &b)
+              { return a.fTrackIndex < b.fTrackIndex; });
+}
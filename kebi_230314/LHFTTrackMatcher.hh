@@ -0,0 +1,91 @@
+#ifndef LHFTTRACKMATCHER_HH
+#define LHFTTRACKMATCHER_HH
+
+#include "TClonesArray.h"
+
+#include "KBHelixTrack.hh"
+#include "KBVector3.hh"
+#include "FTHit.hh"
+
+#include <vector>
+using namespace std;
+
+struct LHFTMatch
+{
+  Int_t fTrackIndex = -1; ///< index in the track array given to MatchTracks
+  Int_t fPlane = -1;
+  FTHit *fHit = nullptr;
+  Int_t fHitIndex = -1; ///< index in the FT hit array given to SetHits
+  Double_t fChi2 = 0;
+  Double_t fLength = 0; ///< extrapolation length from the track end [mm]
+};
+
+/**
+ * TPC-to-FT matching stage run after track finding.
+ *
+ * FT hits are grouped into planes of constant drift-axis coordinate k and
+ * indexed per plane by a 2D k-d tree in (i, j). Each finalized track is
+ * extrapolated from its head or tail to every plane it reaches; the hits
+ * within sqrt(fCutChi2) sigma are ranked by
+ *   chi2 = (di^2 + dj^2) / (fHitResolution^2 + (fExtrapolationError * length)^2).
+ * Candidates of all tracks are then assigned in increasing chi2, so each FT
+ * hit and each (track, plane) pair is used at most once.
+ */
+class LHFTTrackMatcher
+{
+public:
+  LHFTTrackMatcher() {}
+  virtual ~LHFTTrackMatcher() {}
+
+  void SetReferenceAxis(KBVector3::Axis axis) { fReferenceAxis = axis; }
+  void SetPlaneGap(Double_t val) { fPlaneGap = val; }
+  void SetHitResolution(Double_t val) { fHitResolution = val; }
+  void SetExtrapolationError(Double_t val) { fExtrapolationError = val; }
+  void SetCutChi2(Double_t val) { fCutChi2 = val; }
+  void SetMaxExtrapolationLength(Double_t val) { fMaxExtrapolationLength = val; }
+
+  /// Group the hits of ftHitArray (FTHit) into planes and build the k-d trees
+  void SetHits(TClonesArray *ftHitArray);
+  /// Fill matches for the tracks (KBHelixTrack) of trackArray, sorted by track index
+  void MatchTracks(TClonesArray *trackArray, vector<LHFTMatch> &matches);
+
+  Int_t GetNumPlanes() const { return fPlanes.size(); }
+  Double_t GetPlaneK(Int_t plane) const { return fPlanes[plane].fK; }
+
+private:
+  struct FTPoint
+  {
+    Double_t fIJ[2];
+    Double_t fK;
+    FTHit *fHit;
+    Int_t fIndex;
+  };
+
+  struct FTPlane
+  {
+    Double_t fK = 0;
+    vector<FTPoint> fTree; ///< implicit k-d tree : median of [begin, end) at the middle, split axis alternating i, j
+  };
+
+  void BuildTree(vector<FTPoint> &tree, Int_t begin, Int_t end, Int_t axis);
+  void SearchTree(const vector<FTPoint> &tree, Int_t begin, Int_t end, Int_t axis, const Double_t *ij, Double_t range2) const;
+  bool ExtrapolateToPlane(KBHelixTrack *track, Double_t k, TVector3 &position, Double_t &length) const;
+
+  KBVector3::Axis fReferenceAxis = KBVector3::kZ;
+  Double_t fPlaneGap = 5.;                 ///< hits closer than this along k belong to the same plane [mm]
+  Double_t fHitResolution = 0.5;           ///< FT hit resolution in i and j [mm]
+  Double_t fExtrapolationError = 0.01;     ///< extrapolation error per unit of extrapolation length
+  Double_t fCutChi2 = 9.;
+  Double_t fMaxExtrapolationLength = 1500.; ///< [mm]
+  Double_t fProbeLength = 10.;             ///< length used to measure dk/dlength at the track ends [mm]
+
+  Int_t fNumHits = 0;
+  vector<FTPoint> fPoints;
+  vector<FTPlane> fPlanes;
+  mutable vector<const FTPoint *> fFound;
+  vector<LHFTMatch> fCandidates;
+  vector<bool> fHitIsUsed;
+  vector<bool> fTrackPlaneIsUsed;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "KBRun.hh"
+#include "LHRunContext.hh"
+#include "KBMCStep.hh"
+#include "LHFastSimTask.hh"
+#include "FTHit.hh"
+
+#include "TMath.h"
+
+#include <iostream>
+
+ClassImp(LHFastSimTask)
+
+bool LHFastSimTask::Init()
+{
+  auto run = KBRun::GetRun();
+  fPar = run->GetParameterContainer();
+  fTpc = LHRunContext::GetTpc();
+  fPadPlane = (KBPadPlane *)fTpc->GetPadPlane();
+  fReferenceAxis = fPar->GetParAxis("LHTF_refAxis");
+
+  fMCStepArray = (TClonesArray *)LHRunContext::GetBranch(Form("MCStep%d", fTpcDetID));
+  fMCStepArray_FT = (TClonesArray *)LHRunContext::GetBranch(Form("MCStep%d", fFTDetID));
+
+  fHitArray = new TClonesArray("KBTpcHit", 2000);
+  LHRunContext::RegisterBranch(fBranchNameHit, fHitArray, fPersistency);
+
+  fHitArray_FT = new TClonesArray("FTHit", 200);
+  LHRunContext::RegisterBranch(fBranchNameHit_FT, fHitArray_FT, fPersistency);
+
+  return true;
+}
+
+void LHFastSimTask::Exec(Option_t *)
+{
+  if (fUseEventSeed)
+    fRandom.SetSeed(fEventSeed + LHRunContext::GetEventID());
+
+  ExecTpc();
+  ExecFT();
+
+  kb_info << "Fast simulation : " << fHitArray->GetEntriesFast() << " TPC hits, " << fHitArray_FT->GetEntriesFast() << " FT hits" << endl;
+}
+
+void LHFastSimTask::ExecTpc()
+{
+  fHitArray->Clear("C");
+  fHitIndex.clear();
+  fHitEdep.clear();
+  fHitPosition.clear();
+  fHitPadID.clear();
+
+  if (fMCStepArray == nullptr)
+    return;
+
+  // merge steps of the same MC track on the same pad
+  Long64_t numSteps = fMCStepArray->GetEntriesFast();
+  for (Long64_t iStep = 0; iStep < numSteps; ++iStep)
+  {
+    auto step = (KBMCStep *)fMCStepArray->At(iStep);
+    TVector3 position(step->GetX(), step->GetY(), step->GetZ());
+    KBVector3 qos(position, fReferenceAxis);
+
+    Int_t padID = fPadPlane->FindPadID(qos.I(), qos.J());
+    if (padID < 0)
+      continue;
+
+    Long64_t key = Long64_t(step->GetTrackID()) * 1000000 + padID;
+    auto found = fHitIndex.find(key);
+    Int_t index;
+    if (found == fHitIndex.end())
+    {
+      index = fHitEdep.size();
+      fHitIndex[key] = index;
+      fHitEdep.push_back(0.);
+      fHitPosition.push_back(TVector3(0, 0, 0));
+      fHitPadID.push_back(padID);
+    }
+    else
+      index = found->second;
+
+    Double_t edep = step->GetEdep();
+    fHitEdep[index] += edep;
+    fHitPosition[index] = fHitPosition[index] + position * edep;
+  }
+
+  Int_t numMerged = fHitEdep.size();
+  for (Int_t iMerged = 0; iMerged < numMerged; ++iMerged)
+  {
+    if (fHitEdep[iMerged] <= 0)
+      continue;
+
+    KBVector3 qos(fHitPosition[iMerged] * (1. / fHitEdep[iMerged]), fReferenceAxis);
+    Double_t radius = sqrt(qos.I() * qos.I() + qos.J() * qos.J());
+    Double_t drift = abs(qos.K() - fDriftK0);
+
+    if (fRandom.Rndm() > GetEfficiency(radius, drift))
+      continue;
+
+    Double_t sigmaIJ = sqrt(fSigmaIJ0 * fSigmaIJ0 + fDiffusionT * fDiffusionT * drift);
+    Double_t sigmaK = sqrt(fSigmaK0 * fSigmaK0 + fDiffusionL * fDiffusionL * drift);
+    qos.SetI(qos.I() + fRandom.Gaus(0, sigmaIJ));
+    qos.SetJ(qos.J() + fRandom.Gaus(0, sigmaIJ));
+    qos.SetK(qos.K() + fRandom.Gaus(0, sigmaK));
+
+    Int_t padID = fHitPadID[iMerged];
+    auto pad = fPadPlane->GetPad(padID);
+
+    Int_t hitID = fHitArray->GetEntriesFast();
+    auto hit = (KBTpcHit *)fHitArray->ConstructedAt(hitID, "C");
+    hit->SetHitID(hitID);
+    hit->SetPadID(padID);
+    hit->SetSection(pad->GetSection());
+    hit->SetRow(pad->GetRow());
+    hit->SetLayer(pad->GetLayer());
+    hit->SetX(qos.X());
+    hit->SetY(qos.Y());
+    hit->SetZ(qos.Z());
+    hit->SetCharge(fGain * fHitEdep[iMerged]);
+  }
+}
+
+void LHFastSimTask::ExecFT()
+{
+  fHitArray_FT->Clear("C");
+
+  if (fMCStepArray_FT == nullptr)
+    return;
+
+  Long64_t numSteps = fMCStepArray_FT->GetEntriesFast();
+  for (Long64_t iStep = 0; iStep < numSteps; ++iStep)
+  {
+    if (fRandom.Rndm() > fEfficiencyFT)
+      continue;
+
+    auto step = (KBMCStep *)fMCStepArray_FT->At(iStep);
+    KBVector3 qos(TVector3(step->GetX(), step->GetY(), step->GetZ()), fReferenceAxis);
+    qos.SetI(qos.I() + fRandom.Gaus(0, fSigmaFT));
+    qos.SetJ(qos.J() + fRandom.Gaus(0, fSigmaFT));
+
+    Int_t idx = fHitArray_FT->GetEntriesFast();
+    auto hit = (FTHit *)fHitArray_FT->ConstructedAt(idx, "C");
+    hit->SetFTHit(step->GetModuleID(), qos.X(), qos.Y(), qos.Z());
+    hit->SetHitID(40000 + idx);
+    hit->SetCharge(fGain * step->GetEdep());
+  }
+}
+
+Double_t LHFastSimTask::GetEfficiency(Double_t radius, Double_t drift)
+{
+  if (fEfficiencyMap == nullptr)
+    return fEfficiency;
+
+  return fEfficiencyMap->GetBinContent(fEfficiencyMap->FindBin(radius, drift));
+}
@@ -0,0 +1,104 @@
+#ifndef LHFASTSIMTASK_HH
+#define LHFASTSIMTASK_HH
+
+#include "TClonesArray.h"
+#include "TRandom3.h"
+#include "TH2D.h"
+
+#include "KBTask.hh"
+#include "KBTpcHit.hh"
+#include "KBVector3.hh"
+
+#include "LHTpc.hh"
+#include "KBPadPlane.hh"
+
+#include <unordered_map>
+using namespace std;
+
+/**
+ * Parametric fast simulation of the TPC and FT response.
+ *
+ * Replaces LHFTHitTask, LHDriftElectronTask, LHElectronicsTask and KBPSATask
+ * in run.C. Geant4 steps of the TPC (MCStep[fTpcDetID]) are merged per MC
+ * track and pad into one energy-weighted KBTpcHit. The hit is smeared with
+ *   sigma_ij = sqrt(fSigmaIJ0^2 + fDiffusionT^2 * drift)
+ *   sigma_k  = sqrt(fSigmaK0^2  + fDiffusionL^2 * drift)
+ * (drift = |k - fDriftK0|) and kept with the probability of the efficiency
+ * map (radius, drift) or fEfficiency. FT steps (MCStep[fFTDetID]) become
+ * smeared FTHits with fEfficiencyFT. Output branches have the same names and
+ * classes as the full chain, so the tracker input does not change.
+ */
+class LHFastSimTask : public KBTask
+{
+public:
+  LHFastSimTask() : KBTask("LHFastSimTask", "LHFastSimTask") {}
+  virtual ~LHFastSimTask() {}
+
+  virtual bool Init();
+  virtual void Exec(Option_t *);
+
+  void SetTpcDetID(Int_t id) { fTpcDetID = id; }
+  void SetFTDetID(Int_t id) { fFTDetID = id; }
+  void SetHitBranchName(TString name) { fBranchNameHit = name; }
+  void SetHitBranchName_FT(TString name) { fBranchNameHit_FT = name; }
+  void SetPersistency(bool val) { fPersistency = val; }
+
+  void SetSeed(UInt_t seed) { fRandom.SetSeed(seed); }
+  /// Reseed with seed + event number before each event, so the response of an event does not depend on the event loop
+  void SetEventSeed(UInt_t seed)
+  {
+    fUseEventSeed = true;
+    fEventSeed = seed;
+  }
+  void SetResolution(Double_t sigmaIJ0, Double_t sigmaK0) { fSigmaIJ0 = sigmaIJ0; fSigmaK0 = sigmaK0; }
+  void SetDiffusion(Double_t transverse, Double_t longitudinal) { fDiffusionT = transverse; fDiffusionL = longitudinal; }
+  void SetDriftK0(Double_t val) { fDriftK0 = val; } ///< position of the readout plane on the drift axis
+  void SetEfficiency(Double_t val) { fEfficiency = val; }
+  void SetEfficiencyMap(TH2D *map) { fEfficiencyMap = map; } ///< x : radius, y : drift length
+  void SetResolutionFT(Double_t val) { fSigmaFT = val; }
+  void SetEfficiencyFT(Double_t val) { fEfficiencyFT = val; }
+  void SetGain(Double_t val) { fGain = val; } ///< hit charge per unit of deposited energy
+
+private:
+  void ExecTpc();
+  void ExecFT();
+  Double_t GetEfficiency(Double_t radius, Double_t drift);
+
+  LHTpc *fTpc = nullptr;
+  KBPadPlane *fPadPlane = nullptr;
+  KBVector3::Axis fReferenceAxis;
+
+  TClonesArray *fMCStepArray = nullptr;
+  TClonesArray *fMCStepArray_FT = nullptr;
+  TClonesArray *fHitArray = nullptr;
+  TClonesArray *fHitArray_FT = nullptr;
+
+  Int_t fTpcDetID = 10;
+  Int_t fFTDetID = 40;
+  TString fBranchNameHit = "TPCHit";
+  TString fBranchNameHit_FT = "FTHit";
+  bool fPersistency = true;
+
+  TRandom3 fRandom;
+  bool fUseEventSeed = false;
+  UInt_t fEventSeed = 0; ///< > 0, TRandom3 takes seed 0 from the clock
+  Double_t fSigmaIJ0 = 0.3;
+  Double_t fSigmaK0 = 0.5;
+  Double_t fDiffusionT = 0.02; ///< [mm / sqrt(mm)]
+  Double_t fDiffusionL = 0.02; ///< [mm / sqrt(mm)]
+  Double_t fDriftK0 = 0.;
+  Double_t fEfficiency = 1.;
+  TH2D *fEfficiencyMap = nullptr;
+  Double_t fSigmaFT = 0.05;
+  Double_t fEfficiencyFT = 1.;
+  Double_t fGain = 1.;
+
+  unordered_map<Long64_t, Int_t> fHitIndex; //! (MC track, pad) -> hit index
+  vector<Double_t> fHitEdep;                //!
+  vector<TVector3> fHitPosition;            //! energy-weighted sum of step positions
+  vector<Int_t> fHitPadID;                  //!
+
+  ClassDef(LHFastSimTask, 1)
+};
+
+#endif
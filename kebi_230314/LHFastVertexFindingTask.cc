@@ -0,0 +1,275 @@
+#include "KBRun.hh"
+#include "LHRunContext.hh"
+#include "LHFastVertexFindingTask.hh"
+#include "LHParallelFor.hh"
+
+#include "Math/SMatrix.h"
+#include "TMath.h"
+#include "TVector2.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+ClassImp(LHFastVertexFindingTask)
+
+bool LHFastVertexFindingTask::Init()
+{
+  fKalmanTrackArray = (TClonesArray *)LHRunContext::GetBranch(fBranchNameKalman);
+  if (fKalmanTrackArray == nullptr)
+  {
+    kb_error << "No branch " << fBranchNameKalman << endl;
+    return false;
+  }
+
+  fVertexArray = new TClonesArray("LHVertex", 10);
+  LHRunContext::RegisterBranch(fBranchNameVertex, fVertexArray, fPersistency);
+
+  fHistogram.resize(Int_t(ceil((fZMax - fZMin) / fBinWidth)));
+
+  return true;
+}
+
+void LHFastVertexFindingTask::Exec(Option_t *)
+{
+  fVertexArray->Clear("C");
+  fStopwatch.Start(kTRUE);
+
+  fTracks.clear();
+  Int_t numTracks = fKalmanTrackArray->GetEntriesFast();
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    TrackAtDCA trackAtDCA;
+    if (PropagateToBeamLine((LHKalmanTrack *)fKalmanTrackArray->At(iTrack), trackAtDCA))
+      fTracks.push_back(trackAtDCA);
+  }
+
+  FindPeaks();
+
+  Int_t numPeaks = fPeakZ.size();
+  fFits.resize(numPeaks);
+  // starting threads costs more than fitting a few peaks, which LHParallelFor then runs on this thread
+  Int_t numThreads = fNumThreads > 0 ? fNumThreads : Int_t(thread::hardware_concurrency());
+  numThreads = min(numThreads, Int_t(Long64_t(numPeaks) * fTracks.size() / max(fMinTracksPerThread, 1)));
+  LHParallelFor(numPeaks, max(numThreads, 1), [this](int iPeak)
+                { FitVertex(fPeakZ[iPeak], fFits[iPeak]); });
+
+  // strongest candidates first; drop the ones which converged onto a stronger vertex
+  fFitOrder.resize(numPeaks);
+  for (Int_t iPeak = 0; iPeak < numPeaks; ++iPeak)
+    fFitOrder[iPeak] = iPeak;
+  stable_sort(fFitOrder.begin(), fFitOrder.end(), [this](Int_t a, Int_t b)
+              { return fFits[a].fSumOfWeights > fFits[b].fSumOfWeights; });
+
+  for (auto iPeak : fFitOrder)
+  {
+    auto &fit = fFits[iPeak];
+    if (!fit.fIsGood || fit.fSumOfWeights < fMinTracksInPeak)
+      continue;
+
+    bool isDuplicate = false;
+    Int_t numVertices = fVertexArray->GetEntriesFast();
+    for (Int_t iVertex = 0; iVertex < numVertices; ++iVertex)
+    {
+      auto vertex = (LHVertex *)fVertexArray->At(iVertex);
+      if (abs(vertex->GetPosition().Z() - fit.fPosition[2]) < fMinVertexSeparation)
+        isDuplicate = true;
+    }
+    if (isDuplicate)
+      continue;
+
+    auto vertex = (LHVertex *)fVertexArray->ConstructedAt(numVertices, "C");
+    vertex->SetPosition(TVector3(fit.fPosition[0], fit.fPosition[1], fit.fPosition[2]));
+    vertex->SetPositionError(TVector3(fit.fError[0], fit.fError[1], fit.fError[2]));
+    vertex->SetChi2(fit.fChi2);
+    vertex->SetSumOfWeights(fit.fSumOfWeights);
+    Int_t numUsed = fTracks.size();
+    for (Int_t iTrack = 0; iTrack < numUsed; ++iTrack)
+      if (fit.fWeights[iTrack] > 0.5)
+        vertex->AddTrack(fTracks[iTrack].fTrackID);
+  }
+
+  fStopwatch.Stop();
+  fRealTime += fStopwatch.RealTime();
+  fNumTracks += numTracks;
+
+  kb_info << "Vertex finding : " << fVertexArray->GetEntriesFast() << " vertices from " << fTracks.size() << " / " << numTracks << " tracks ("
+          << numPeaks << " peaks), " << 1000 * fStopwatch.RealTime() << " ms" << endl;
+}
+
+bool LHFastVertexFindingTask::PropagateToBeamLine(const LHKalmanTrack *track, TrackAtDCA &trackAtDCA) const
+{
+  TVector3 position = track->PositionIJK();
+  Double_t phi = asin(track->GetParameter(2)) + track->GetAlpha();
+  Double_t tgl = track->GetParameter(3);
+  Double_t crv = track->Curvature(fBField);
+
+  Double_t cosPhi = cos(phi), sinPhi = sin(phi);
+  Double_t ds;
+  if (abs(crv) < 1.e-9)
+    ds = -(position.X() * cosPhi + position.Y() * sinPhi);
+  else
+  {
+    // the track turns counterclockwise around the center for crv > 0; the DCA lies on the ray from the center to the beam line
+    Double_t ci = position.X() - sinPhi / crv;
+    Double_t cj = position.Y() + cosPhi / crv;
+    Double_t dTheta = atan2(-cj, -ci) - atan2(position.Y() - cj, position.X() - ci);
+    dTheta = TVector2::Phi_mpi_pi(dTheta);
+    ds = dTheta / crv;
+  }
+
+  Double_t phiAtDCA = phi + crv * ds;
+  Double_t i0 = position.X(), j0 = position.Y();
+  if (abs(crv) < 1.e-9)
+  {
+    i0 += ds * cosPhi;
+    j0 += ds * sinPhi;
+  }
+  else
+  {
+    i0 += (sin(phiAtDCA) - sinPhi) / crv;
+    j0 -= (cos(phiAtDCA) - cosPhi) / crv;
+  }
+  Double_t k0 = position.Z() + tgl * ds;
+
+  if (i0 * i0 + j0 * j0 > fCutDCA * fCutDCA)
+    return false;
+
+  Double_t norm = sqrt(1. + tgl * tgl);
+  trackAtDCA.fTrackID = track->GetTrackID();
+  trackAtDCA.fPoint[0] = i0;
+  trackAtDCA.fPoint[1] = j0;
+  trackAtDCA.fPoint[2] = k0;
+  trackAtDCA.fDirection[0] = cos(phiAtDCA) / norm;
+  trackAtDCA.fDirection[1] = sin(phiAtDCA) / norm;
+  trackAtDCA.fDirection[2] = tgl / norm;
+
+  Double_t sigma2K = track->GetCovariance(1, 1) + ds * ds * track->GetCovariance(3, 3) + 2 * ds * track->GetCovariance(3, 1);
+  trackAtDCA.fSigma2 = max(sigma2K, fMinSigma * fMinSigma);
+
+  return true;
+}
+
+void LHFastVertexFindingTask::FindPeaks()
+{
+  fill(fHistogram.begin(), fHistogram.end(), 0.);
+  fPeakZ.clear();
+
+  Int_t numBins = fHistogram.size();
+  for (auto &track : fTracks)
+  {
+    Int_t bin = Int_t((track.fPoint[2] - fZMin) / fBinWidth);
+    if (bin >= 0 && bin < numBins)
+      fHistogram[bin] += 1.;
+  }
+
+  // local maxima of the 3-bin sum; ties are resolved towards the lower bin
+  vector<pair<Double_t, Double_t>> peaks;
+  auto sum3 = [this, numBins](Int_t bin)
+  {
+    Double_t sum = 0;
+    for (Int_t b = bin - 1; b <= bin + 1; ++b)
+      if (b >= 0 && b < numBins)
+        sum += fHistogram[b];
+    return sum;
+  };
+
+  for (Int_t bin = 0; bin < numBins; ++bin)
+  {
+    if (fHistogram[bin] == 0)
+      continue;
+
+    Double_t content = sum3(bin);
+    if (content < fMinTracksInPeak || content <= sum3(bin - 1) || content < sum3(bin + 1))
+      continue;
+
+    Double_t zSum = 0;
+    for (Int_t b = max(bin - 1, 0); b <= min(bin + 1, numBins - 1); ++b)
+      zSum += fHistogram[b] * (fZMin + (b + 0.5) * fBinWidth);
+    peaks.push_back(make_pair(content, zSum / content));
+  }
+
+  stable_sort(peaks.begin(), peaks.end(), [](const pair<Double_t, Double_t> &a, const pair<Double_t, Double_t> &b)
+              { return a.first > b.first; });
+
+  Int_t numPeaks = min(Int_t(peaks.size()), fMaxNumVertices);
+  for (Int_t iPeak = 0; iPeak < numPeaks; ++iPeak)
+    fPeakZ.push_back(peaks[iPeak].second);
+}
+
+void LHFastVertexFindingTask::FitVertex(Double_t zSeed, VertexFit &fit) const
+{
+  typedef ROOT::Math::SMatrix<Double_t, 3, 3, ROOT::Math::MatRepSym<Double_t, 3>> SymMatrix3;
+
+  Int_t numTracks = fTracks.size();
+  fit.fWeights.assign(numTracks, 0.);
+  fit.fPosition[0] = 0;
+  fit.fPosition[1] = 0;
+  fit.fPosition[2] = zSeed;
+  fit.fIsGood = false;
+
+  // squared distance of the vertex to the straight track line, over the track error
+  auto chi2OfTrack = [&fit](const TrackAtDCA &track)
+  {
+    Double_t d[3], dot = 0;
+    for (Int_t a = 0; a < 3; ++a)
+    {
+      d[a] = fit.fPosition[a] - track.fPoint[a];
+      dot += d[a] * track.fDirection[a];
+    }
+    Double_t dist2 = 0;
+    for (Int_t a = 0; a < 3; ++a)
+      dist2 += pow(d[a] - dot * track.fDirection[a], 2);
+    return dist2 / track.fSigma2;
+  };
+
+  SymMatrix3 matrix;
+  for (auto temperature : fTemperatures)
+  {
+    matrix = SymMatrix3();
+    Double_t vector[3] = {0, 0, 0};
+    Double_t sumOfWeights = 0;
+
+    for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+    {
+      auto &track = fTracks[iTrack];
+      Double_t weight = 1. / (1. + exp((chi2OfTrack(track) - fCutChi2) / (2. * temperature)));
+      fit.fWeights[iTrack] = weight;
+      if (weight < 1.e-3)
+        continue;
+      sumOfWeights += weight;
+
+      // w / sigma^2 * (1 - u u^T), and the same projector applied to the DCA point
+      Double_t w = weight / track.fSigma2;
+      const Double_t *u = track.fDirection;
+      Double_t uDotP = u[0] * track.fPoint[0] + u[1] * track.fPoint[1] + u[2] * track.fPoint[2];
+      for (Int_t a = 0; a < 3; ++a)
+      {
+        for (Int_t b = 0; b <= a; ++b)
+          matrix(a, b) += w * ((a == b ? 1. : 0.) - u[a] * u[b]);
+        vector[a] += w * (track.fPoint[a] - uDotP * u[a]);
+      }
+    }
+
+    if (sumOfWeights < 2. || !matrix.Invert())
+      return;
+
+    for (Int_t a = 0; a < 3; ++a)
+      fit.fPosition[a] = matrix(a, 0) * vector[0] + matrix(a, 1) * vector[1] + matrix(a, 2) * vector[2];
+  }
+
+  fit.fChi2 = 0;
+  fit.fSumOfWeights = 0;
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    Double_t chi2 = chi2OfTrack(fTracks[iTrack]);
+    Double_t weight = 1. / (1. + exp((chi2 - fCutChi2) / (2. * fTemperatures.back())));
+    fit.fWeights[iTrack] = weight;
+    fit.fChi2 += weight * chi2;
+    fit.fSumOfWeights += weight;
+  }
+  for (Int_t a = 0; a < 3; ++a)
+    fit.fError[a] = sqrt(matrix(a, a));
+
+  fit.fIsGood = true;
+}
@@ -0,0 +1,115 @@
+#ifndef LHFASTVERTEXFINDINGTASK_HH
+#define LHFASTVERTEXFINDINGTASK_HH
+
+#include "TClonesArray.h"
+#include "TStopwatch.h"
+
+#include "KBTask.hh"
+
+#include "LHKalmanTrack.hh"
+#include "LHVertex.hh"
+
+#include <vector>
+using namespace std;
+
+/**
+ * Histogram-based primary vertex finder.
+ *
+ * The refitted tracks (LHKalmanTrack) are propagated analytically to their
+ * point of closest approach to the beam line (i = j = 0). Tracks with a DCA
+ * below fCutDCA fill a histogram of z0 (the drift-axis coordinate at the
+ * DCA), and its local maxima are the vertex candidates. Each candidate is
+ * refined independently by an adaptive
+ * weighted least-squares fit of the vertex position to the straight-line
+ * approximations of the tracks at their DCA, with deterministic annealing of
+ * the weights w = 1 / (1 + exp((chi2 - fCutChi2) / (2 T))). Candidates which
+ * converge within fMinVertexSeparation of a stronger one are dropped.
+ * The fits run on up to fNumThreads threads, one thread per
+ * fMinTracksPerThread track fits (peaks times tracks), so events with a few
+ * peaks are fitted on the calling thread without starting threads.
+ */
+class LHFastVertexFindingTask : public KBTask
+{
+public:
+  LHFastVertexFindingTask() : KBTask("LHFastVertexFindingTask", "LHFastVertexFindingTask") {}
+  virtual ~LHFastVertexFindingTask() {}
+
+  virtual bool Init();
+  virtual void Exec(Option_t *);
+
+  void SetKalmanTrackBranchName(TString name) { fBranchNameKalman = name; }
+  void SetVertexBranchName(TString name) { fBranchNameVertex = name; }
+  void SetPersistency(bool val) { fPersistency = val; }
+
+  void SetBField(Double_t val) { fBField = val; } ///< [T], same as LHKalmanRefitTask
+  void SetNumThreads(Int_t val) { fNumThreads = val; }
+  void SetMinTracksPerThread(Int_t val) { fMinTracksPerThread = val; }
+  void SetZRange(Double_t min, Double_t max) { fZMin = min; fZMax = max; }
+  void SetBinWidth(Double_t val) { fBinWidth = val; }
+  void SetCutDCA(Double_t val) { fCutDCA = val; }
+  void SetMinTracksInPeak(Double_t val) { fMinTracksInPeak = val; }
+  void SetMaxNumVertices(Int_t val) { fMaxNumVertices = val; }
+  void SetMinVertexSeparation(Double_t val) { fMinVertexSeparation = val; }
+  void SetCutChi2(Double_t val) { fCutChi2 = val; }
+
+  Double_t GetRealTime() const { return fRealTime; } ///< summed vertex finding time of all events [s]
+  Long64_t GetNumTracks() const { return fNumTracks; } ///< summed number of input tracks of all events
+
+private:
+  struct TrackAtDCA
+  {
+    Int_t fTrackID;
+    Double_t fPoint[3];     ///< (i, j, k) at the DCA
+    Double_t fDirection[3]; ///< unit direction at the DCA
+    Double_t fSigma2;       ///< squared position error used as weight
+  };
+
+  struct VertexFit
+  {
+    Double_t fPosition[3];
+    Double_t fError[3];
+    Double_t fChi2;
+    Double_t fSumOfWeights;
+    vector<Double_t> fWeights;
+    bool fIsGood;
+  };
+
+  bool PropagateToBeamLine(const LHKalmanTrack *track, TrackAtDCA &trackAtDCA) const;
+  void FindPeaks();
+  void FitVertex(Double_t zSeed, VertexFit &fit) const;
+
+  TClonesArray *fKalmanTrackArray = nullptr;
+  TClonesArray *fVertexArray = nullptr;
+
+  TString fBranchNameKalman = "KalmanTrack";
+  TString fBranchNameVertex = "Vertex";
+  bool fPersistency = true;
+
+  Double_t fBField = 0.5;
+  Int_t fNumThreads = 0; ///< 0 : use all hardware threads
+  Int_t fMinTracksPerThread = 2000; ///< peak fits of fewer tracks (summed over the peaks) than this per thread run inline
+  Double_t fZMin = -500.;
+  Double_t fZMax = 500.;
+  Double_t fBinWidth = 2.;
+  Double_t fCutDCA = 20.;            ///< [mm]
+  Double_t fMinTracksInPeak = 2.;    ///< minimum content of a peak (3-bin sum)
+  Int_t fMaxNumVertices = 10;
+  Double_t fMinVertexSeparation = 5.; ///< [mm]
+  Double_t fCutChi2 = 9.;
+  Double_t fMinSigma = 0.5; ///< lower limit of the track position error [mm]
+  vector<Double_t> fTemperatures = {64., 16., 4., 1., 1., 1.};
+
+  vector<TrackAtDCA> fTracks;     //!
+  vector<Double_t> fHistogram;    //!
+  vector<Double_t> fPeakZ;        //!
+  vector<VertexFit> fFits;        //!
+  vector<Int_t> fFitOrder;        //!
+
+  TStopwatch fStopwatch; //!
+  Double_t fRealTime = 0;
+  Long64_t fNumTracks = 0;
+
+  ClassDef(LHFastVertexFindingTask, 1)
+};
+
+#endif
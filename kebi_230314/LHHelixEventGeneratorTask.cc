@@ -0,0 +1,188 @@
+#include "KBRun.hh"
+#include "LHHelixEventGeneratorTask.hh"
+#include "FTHit.hh"
+
+#include "TMath.h"
+
+#include <iostream>
+
+ClassImp(LHHelixEventGeneratorTask)
+
+bool LHHelixEventGeneratorTask::Init()
+{
+  auto run = KBRun::GetRun();
+  fPar = run->GetParameterContainer();
+  fTpc = (LHTpc *)(run->GetDetectorSystem()->GetTpc());
+  fPadPlane = (KBPadPlane *)fTpc->GetPadPlane();
+  fReferenceAxis = fPar->GetParAxis("LHTF_refAxis");
+
+  // (i,j,k) = M (x,y,z) with M a signed permutation, so (x,y,z) = M^T (i,j,k)
+  TVector3 units[3] = {TVector3(1, 0, 0), TVector3(0, 1, 0), TVector3(0, 0, 1)};
+  for (Int_t xyz = 0; xyz < 3; ++xyz)
+  {
+    KBVector3 ijk(units[xyz], fReferenceAxis);
+    fIJKToXYZ[xyz][0] = ijk.I();
+    fIJKToXYZ[xyz][1] = ijk.J();
+    fIJKToXYZ[xyz][2] = ijk.K();
+  }
+
+  fHitArray = new TClonesArray("KBTpcHit", 2000);
+  run->RegisterBranch(fBranchNameHit, fHitArray, fPersistency);
+
+  fHitArray_FT = new TClonesArray("FTHit", 200);
+  run->RegisterBranch(fBranchNameHit_FT, fHitArray_FT, fPersistency);
+
+  return true;
+}
+
+void LHHelixEventGeneratorTask::Exec(Option_t *)
+{
+  fHitArray->Clear("C");
+  fHitArray_FT->Clear("C");
+  fHitMCID.clear();
+  fHitMCID_FT.clear();
+  fMCNumHits.assign(fNumTracks, 0);
+
+  for (Int_t mcTrackID = 0; mcTrackID < fNumTracks; ++mcTrackID)
+    GenerateTrack(mcTrackID);
+
+  GenerateNoise();
+
+  kb_info << "Generated " << fNumTracks << " helices, " << fHitArray->GetEntriesFast() << " TPC hits, " << fHitArray_FT->GetEntriesFast() << " FT hits" << endl;
+}
+
+Int_t LHHelixEventGeneratorTask::GetMCTrackID(Int_t hitID) const
+{
+  if (hitID >= 40000)
+  {
+    hitID -= 40000;
+    return (hitID < Int_t(fHitMCID_FT.size()) ? fHitMCID_FT[hitID] : -1);
+  }
+  return (hitID >= 0 && hitID < Int_t(fHitMCID.size()) ? fHitMCID[hitID] : -1);
+}
+
+void LHHelixEventGeneratorTask::GenerateTrack(Int_t mcTrackID)
+{
+  Double_t pt = fRandom.Uniform(fPtMin, fPtMax);
+  Double_t dip = fRandom.Uniform(fDipMin, fDipMax);
+  Double_t phi0 = fRandom.Uniform(-TMath::Pi(), TMath::Pi());
+  Double_t charge = (fRandom.Rndm() < .5 ? -1 : 1);
+
+  Double_t radius = 1000. * pt / (0.3 * fBField); // [mm]
+  Double_t tanDip = tan(dip);
+
+  // helix center on the left (charge > 0) or right of the initial direction
+  Double_t ci = -charge * radius * sin(phi0);
+  Double_t cj = charge * radius * cos(phi0);
+  Double_t alpha0 = TMath::ATan2(-cj, -ci);
+
+  Double_t kMin = fKMin, kMax = fKMax;
+  for (auto kPlane : fFTPlaneK)
+  {
+    if (kPlane < kMin)
+      kMin = kPlane;
+    if (kPlane > kMax)
+      kMax = kPlane;
+  }
+
+  Int_t prevPadID = -1;
+  Double_t kPrev = fVertexK;
+  Int_t numSteps = Int_t(TMath::Pi() * radius / fStepLength);
+  for (Int_t iStep = 1; iStep <= numSteps; ++iStep)
+  {
+    Double_t length = iStep * fStepLength;
+    Double_t alpha = alpha0 + charge * length / radius;
+    Double_t i = ci + radius * cos(alpha);
+    Double_t j = cj + radius * sin(alpha);
+    Double_t k = fVertexK + length * tanDip;
+
+    if (k < kMin || k > kMax || sqrt(i * i + j * j) > fRMax)
+      break;
+
+    for (UInt_t iPlane = 0; iPlane < fFTPlaneK.size(); ++iPlane)
+    {
+      auto kPlane = fFTPlaneK[iPlane];
+      if ((kPrev - kPlane) * (k - kPlane) <= 0 && kPrev != kPlane)
+        AddFTHit(iPlane, i, j, kPlane, mcTrackID);
+    }
+    kPrev = k;
+
+    if (k < fKMin || k > fKMax || !fPadPlane->IsInBoundary(i, j))
+      continue;
+
+    Int_t padID = fPadPlane->FindPadID(i, j);
+    if (padID < 0 || padID == prevPadID)
+      continue;
+
+    AddTpcHit(padID, i, j, k, mcTrackID);
+    prevPadID = padID;
+  }
+}
+
+void LHHelixEventGeneratorTask::GenerateNoise()
+{
+  for (Int_t iNoise = 0; iNoise < fNumNoiseHits; ++iNoise)
+  {
+    for (Int_t iTry = 0; iTry < 100; ++iTry)
+    {
+      Double_t r = fRMax * sqrt(fRandom.Rndm());
+      Double_t phi = fRandom.Uniform(-TMath::Pi(), TMath::Pi());
+      Double_t i = r * cos(phi);
+      Double_t j = r * sin(phi);
+      Int_t padID = fPadPlane->FindPadID(i, j);
+      if (padID < 0)
+        continue;
+
+      AddTpcHit(padID, i, j, fRandom.Uniform(fKMin, fKMax), -1);
+      break;
+    }
+  }
+}
+
+KBTpcHit *LHHelixEventGeneratorTask::AddTpcHit(Int_t padID, Double_t i, Double_t j, Double_t k, Int_t mcTrackID)
+{
+  Int_t hitID = fHitArray->GetEntriesFast();
+  auto hit = (KBTpcHit *)fHitArray->ConstructedAt(hitID, "C");
+  auto pad = fPadPlane->GetPad(padID);
+
+  auto position = ToXYZ(i + fRandom.Gaus(0, fSigmaIJ), j + fRandom.Gaus(0, fSigmaIJ), k + fRandom.Gaus(0, fSigmaK));
+  hit->SetHitID(hitID);
+  hit->SetPadID(padID);
+  hit->SetSection(pad->GetSection());
+  hit->SetRow(pad->GetRow());
+  hit->SetLayer(pad->GetLayer());
+  hit->SetX(position.X());
+  hit->SetY(position.Y());
+  hit->SetZ(position.Z());
+  hit->SetCharge(fRandom.Landau(100, 20));
+
+  fHitMCID.push_back(mcTrackID);
+  if (mcTrackID >= 0)
+    fMCNumHits[mcTrackID]++;
+
+  return hit;
+}
+
+void LHHelixEventGeneratorTask::AddFTHit(Int_t plane, Double_t i, Double_t j, Double_t k, Int_t mcTrackID)
+{
+  Int_t idx = fHitArray_FT->GetEntriesFast();
+  auto hit = (FTHit *)fHitArray_FT->ConstructedAt(idx, "C");
+
+  auto position = ToXYZ(i + fRandom.Gaus(0, fSigmaIJ), j + fRandom.Gaus(0, fSigmaIJ), k);
+  hit->SetFTHit(plane, position.X(), position.Y(), position.Z());
+  hit->SetHitID(40000 + idx);
+  hit->SetCharge(1);
+
+  fHitMCID_FT.push_back(mcTrackID);
+}
+
+TVector3 LHHelixEventGeneratorTask::ToXYZ(Double_t i, Double_t j, Double_t k)
+{
+  Double_t ijk[3] = {i, j, k};
+  Double_t xyz[3] = {0, 0, 0};
+  for (Int_t a = 0; a < 3; ++a)
+    for (Int_t b = 0; b < 3; ++b)
+      xyz[a] += fIJKToXYZ[a][b] * ijk[b];
+
+  return TVector3(xyz[0], xyz[1], xyz[2]);
+}
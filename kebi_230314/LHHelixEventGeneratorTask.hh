@@ -0,0 +1,101 @@
+#ifndef LHHELIXEVENTGENERATORTASK_HH
+#define LHHELIXEVENTGENERATORTASK_HH
+
+#include "TClonesArray.h"
+#include "TRandom3.h"
+
+#include "KBTask.hh"
+#include "KBTpcHit.hh"
+#include "KBVector3.hh"
+
+#include "LHTpc.hh"
+#include "KBPadPlane.hh"
+
+#include <vector>
+using namespace std;
+
+/**
+ * Synthetic event generator for tracking studies.
+ *
+ * Generates fNumTracks helices from a common vertex and fills the TPC hit
+ * branch (KBTpcHit, one hit per crossed pad of the LHTpc pad plane) and the
+ * FT hit branch (FTHit, one hit per crossed FT plane) directly, without
+ * Geant4 or digitization. Transverse momentum, dip angle, position smearing
+ * and the number of noise hits are configurable. The generating MC track of
+ * every hit is kept in GetMCTrackID (-1 for noise) for the tracking
+ * benchmark (LHTrackingBenchmarkTask).
+ */
+class LHHelixEventGeneratorTask : public KBTask
+{
+public:
+  LHHelixEventGeneratorTask() : KBTask("LHHelixEventGeneratorTask", "LHHelixEventGeneratorTask") {}
+  virtual ~LHHelixEventGeneratorTask() {}
+
+  virtual bool Init();
+  virtual void Exec(Option_t *);
+
+  void SetHitBranchName(TString name) { fBranchNameHit = name; }
+  void SetHitBranchName_FT(TString name) { fBranchNameHit_FT = name; }
+  void SetPersistency(bool val) { fPersistency = val; }
+
+  void SetSeed(UInt_t seed) { fRandom.SetSeed(seed); }
+  void SetNumTracks(Int_t val) { fNumTracks = val; }
+  void SetPtRange(Double_t min, Double_t max) { fPtMin = min; fPtMax = max; } ///< [GeV/c]
+  void SetDipRange(Double_t min, Double_t max) { fDipMin = min; fDipMax = max; } ///< [rad]
+  void SetBField(Double_t val) { fBField = val; } ///< [T]
+  void SetVertexK(Double_t val) { fVertexK = val; }
+  void SetKRange(Double_t min, Double_t max) { fKMin = min; fKMax = max; } ///< drift-axis range of the TPC
+  void SetPositionSigma(Double_t sigmaIJ, Double_t sigmaK) { fSigmaIJ = sigmaIJ; fSigmaK = sigmaK; }
+  void SetNumNoiseHits(Int_t val) { fNumNoiseHits = val; }
+  void SetMaxRadius(Double_t val) { fRMax = val; } ///< tracks are followed and noise is generated up to this radius
+  void AddFTPlane(Double_t k) { fFTPlaneK.push_back(k); } ///< FT module plane position on the drift axis
+
+  Int_t GetNumTracks() const { return fNumTracks; }
+  Int_t GetNumGeneratedHits() const { return fHitMCID.size() + fHitMCID_FT.size(); } ///< TPC, FT and noise hits of the current event
+  Int_t GetMCTrackID(Int_t hitID) const;
+  Int_t GetMCNumHits(Int_t mcTrackID) const { return fMCNumHits[mcTrackID]; }
+
+private:
+  void GenerateTrack(Int_t mcTrackID);
+  void GenerateNoise();
+  KBTpcHit *AddTpcHit(Int_t padID, Double_t i, Double_t j, Double_t k, Int_t mcTrackID);
+  void AddFTHit(Int_t plane, Double_t i, Double_t j, Double_t k, Int_t mcTrackID);
+  TVector3 ToXYZ(Double_t i, Double_t j, Double_t k);
+
+  LHTpc *fTpc = nullptr;
+  KBPadPlane *fPadPlane = nullptr;
+  TClonesArray *fHitArray = nullptr;
+  TClonesArray *fHitArray_FT = nullptr;
+
+  TString fBranchNameHit = "TPCHit";
+  TString fBranchNameHit_FT = "FTHit";
+  bool fPersistency = false;
+
+  KBVector3::Axis fReferenceAxis;
+  Double_t fIJKToXYZ[3][3]; ///< inverse of the KBVector3 (x,y,z) -> (i,j,k) mapping
+
+  TRandom3 fRandom;
+  Int_t fNumTracks = 10;
+  Double_t fPtMin = 0.2;
+  Double_t fPtMax = 2.;
+  Double_t fDipMin = -0.8;
+  Double_t fDipMax = 0.8;
+  Double_t fBField = 0.5;
+  Double_t fVertexK = 0.;
+  Double_t fKMin = -600.;
+  Double_t fKMax = 600.;
+  Double_t fSigmaIJ = 0.5;
+  Double_t fSigmaK = 1.;
+  Double_t fStepLength = 1.;  ///< transverse step along the helix
+  Int_t fNumNoiseHits = 0;
+  Double_t fRMax = 600.;
+  vector<Double_t> fFTPlaneK;
+
+  vector<Int_t> fHitMCID;    //! MC track of TPC hit (index = hit ID)
+  vector<Int_t> fHitMCID_FT; //! MC track of FT hit (index = hit ID - 40000)
+  vector<Int_t> fMCNumHits;  //! number of TPC hits per MC track
+
+  ClassDef(LHHelixEventGeneratorTask, 1)
+};
+
+#endif
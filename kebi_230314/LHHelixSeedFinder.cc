@@ -0,0 +1,425 @@
+#include "LHHelixSeedFinder.hh"
+#include "LHParallelFor.hh"
+
+#include "TMath.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <cmath>
+
+void LHHelixSeedFinder::FindSeeds(TClonesArray *hitArray, vector<LHHelixSeed> &seeds)
+{
+  vector<KBTpcHit *> hits;
+  Int_t numHits = hitArray->GetEntriesFast();
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+    hits.push_back((KBTpcHit *)hitArray->At(iHit));
+
+  FindSeeds(hits, seeds);
+}
+
+void LHHelixSeedFinder::FindSeeds(const vector<KBTpcHit *> &hits, vector<LHHelixSeed> &seeds)
+{
+  seeds.clear();
+
+  BuildLayers(hits);
+  FindTriplets();
+
+  Int_t numTriplets = fTriplets.size();
+  vector<LHHelixSeed> candidates(numTriplets);
+  LHParallelFor(numTriplets, fNumThreads, [&](int iTriplet)
+                { ExtendTriplet(iTriplet, candidates[iTriplet]); });
+
+  ResolveConflicts(candidates, seeds);
+}
+
+void LHHelixSeedFinder::BuildLayers(const vector<KBTpcHit *> &hits)
+{
+  // keep the per-layer vectors (and their capacity) from earlier events
+  for (auto &layer : fLayers)
+    layer.clear();
+  fTriplets.clear();
+
+  if (hits.empty())
+    return;
+
+  Int_t layerMin = 0, layerMax = -1;
+  for (auto hit : hits)
+  {
+    auto layer = hit->GetLayer();
+    if (layerMax < layerMin)
+      layerMin = layerMax = layer;
+    if (layer < layerMin)
+      layerMin = layer;
+    if (layer > layerMax)
+      layerMax = layer;
+  }
+
+  fLayerOffset = layerMin;
+  if (Int_t(fLayers.size()) < layerMax - layerMin + 1)
+    fLayers.resize(layerMax - layerMin + 1);
+
+  for (auto hit : hits)
+  {
+    if (hit->GetNumTrackCands() != 0)
+      continue;
+
+    KBVector3 qos(hit->GetPosition(), fReferenceAxis);
+    SeedPoint point;
+    point.fHit = hit;
+    point.fI = qos.I();
+    point.fJ = qos.J();
+    point.fK = qos.K();
+    point.fPhi = TMath::ATan2(point.fJ, point.fI);
+    point.fLayer = hit->GetLayer() - fLayerOffset;
+    fLayers[point.fLayer].push_back(point);
+  }
+
+  for (auto &layer : fLayers)
+    sort(layer.begin(), layer.end(), [](const SeedPoint &a, const SeedPoint &b)
+         { return a.fPhi < b.fPhi; });
+}
+
+void LHHelixSeedFinder::FindInPhiWindow(Int_t layer, Double_t phi, Double_t dphi, vector<Int_t> &found) const
+{
+  found.clear();
+  if (layer < 0 || layer >= Int_t(fLayers.size()))
+    return;
+
+  const auto &points = fLayers[layer];
+  if (points.empty())
+    return;
+
+  if (dphi >= TMath::Pi())
+  {
+    for (Int_t i = 0; i < Int_t(points.size()); ++i)
+      found.push_back(i);
+    return;
+  }
+
+  auto collect = [&](Double_t phi1, Double_t phi2)
+  {
+    auto it = lower_bound(points.begin(), points.end(), phi1, [](const SeedPoint &a, Double_t v)
+                          { return a.fPhi < v; });
+    for (; it != points.end() && it->fPhi <= phi2; ++it)
+      found.push_back(it - points.begin());
+  };
+
+  Double_t phi1 = phi - dphi;
+  Double_t phi2 = phi + dphi;
+  if (phi1 < -TMath::Pi())
+  {
+    collect(phi1 + TMath::TwoPi(), TMath::Pi());
+    collect(-TMath::Pi(), phi2);
+  }
+  else if (phi2 > TMath::Pi())
+  {
+    collect(phi1, TMath::Pi());
+    collect(-TMath::Pi(), phi2 - TMath::TwoPi());
+  }
+  else
+    collect(phi1, phi2);
+}
+
+void LHHelixSeedFinder::FindTriplets()
+{
+  fTriplets.clear();
+
+  Int_t numLayers = fLayers.size();
+  vector<Int_t> found1, found2;
+
+  for (Int_t layer = 0; layer < numLayers - 2; ++layer)
+  {
+    for (Int_t i0 = 0; i0 < Int_t(fLayers[layer].size()); ++i0)
+    {
+      const auto &p0 = fLayers[layer][i0];
+      auto r0 = sqrt(p0.fI * p0.fI + p0.fJ * p0.fJ);
+      auto dphi0 = fCutDoubletDist / (r0 > 1. ? r0 : 1.);
+
+      FindInPhiWindow(layer + 1, p0.fPhi, dphi0, found1);
+      for (auto i1 : found1)
+      {
+        const auto &p1 = fLayers[layer + 1][i1];
+        auto di1 = p1.fI - p0.fI;
+        auto dj1 = p1.fJ - p0.fJ;
+        auto ds1 = sqrt(di1 * di1 + dj1 * dj1);
+        auto dk1 = p1.fK - p0.fK;
+        if (ds1 > fCutDoubletDist || abs(dk1) > fCutDoubletDk || ds1 == 0)
+          continue;
+
+        auto r1 = sqrt(p1.fI * p1.fI + p1.fJ * p1.fJ);
+        auto dphi1 = fCutDoubletDist / (r1 > 1. ? r1 : 1.);
+
+        FindInPhiWindow(layer + 2, p1.fPhi, dphi1, found2);
+        for (auto i2 : found2)
+        {
+          const auto &p2 = fLayers[layer + 2][i2];
+          auto di2 = p2.fI - p1.fI;
+          auto dj2 = p2.fJ - p1.fJ;
+          auto ds2 = sqrt(di2 * di2 + dj2 * dj2);
+          auto dk2 = p2.fK - p1.fK;
+          if (ds2 > fCutDoubletDist || abs(dk2) > fCutDoubletDk || ds2 == 0)
+            continue;
+
+          auto cosAngle = (di1 * di2 + dj1 * dj2) / (ds1 * ds2);
+          if (cosAngle < cos(fCutTripletAngle))
+            continue;
+
+          if (abs(dk1 / ds1 - dk2 / ds2) > fCutTripletDip)
+            continue;
+
+          // collinear triplets have no circle (their radius 1e7 would pass the radius cut)
+          Circle circle;
+          if (!CircleFrom3(p0, p1, p2, circle) || circle.fR < fCutMinHelixRadius)
+            continue;
+
+          fTriplets.push_back({layer, i0, layer + 1, i1, layer + 2, i2});
+        }
+      }
+    }
+  }
+}
+
+Int_t LHHelixSeedFinder::FindBestInLayer(Int_t layer, const SeedPoint &last, const Circle &circle, Double_t tanDip, Int_t numMissing) const
+{
+  auto distCut = (numMissing + 1) * fCutDoubletDist;
+  auto r = sqrt(last.fI * last.fI + last.fJ * last.fJ);
+
+  static thread_local vector<Int_t> found;
+  FindInPhiWindow(layer, last.fPhi, distCut / (r > 1. ? r : 1.), found);
+
+  Int_t best = -1;
+  Double_t bestScore = 0;
+  for (auto idx : found)
+  {
+    const auto &point = fLayers[layer][idx];
+    auto di = point.fI - last.fI;
+    auto dj = point.fJ - last.fJ;
+    if (sqrt(di * di + dj * dj) > distCut)
+      continue;
+
+    auto ci = point.fI - circle.fI;
+    auto cj = point.fJ - circle.fJ;
+    auto residual = abs(sqrt(ci * ci + cj * cj) - circle.fR);
+    if (residual > fCutExtendResidual)
+      continue;
+
+    auto dkResidual = abs(point.fK - (last.fK + tanDip * ArcLength(circle, last, point)));
+    if (dkResidual > (numMissing + 1) * fCutDoubletDk)
+      continue;
+
+    auto score = residual * residual + dkResidual * dkResidual;
+    if (best < 0 || score < bestScore)
+    {
+      best = idx;
+      bestScore = score;
+    }
+  }
+
+  return best;
+}
+
+void LHHelixSeedFinder::ExtendTriplet(Int_t iTriplet, LHHelixSeed &seed) const
+{
+  const auto &triplet = fTriplets[iTriplet];
+  const auto &p0 = fLayers[triplet[0]][triplet[1]];
+  const auto &p1 = fLayers[triplet[2]][triplet[3]];
+  const auto &p2 = fLayers[triplet[4]][triplet[5]];
+
+  // seeds without hits are dropped by ResolveConflicts
+  Circle circle;
+  if (!CircleFrom3(p0, p1, p2, circle))
+  {
+    seed.fHits.clear();
+    return;
+  }
+
+  auto length = ArcLength(circle, p0, p1) + ArcLength(circle, p1, p2);
+  Double_t tanDip = length > 0 ? (p2.fK - p0.fK) / length : 0;
+
+  vector<const SeedPoint *> points = {&p0, &p1, &p2};
+  Int_t numLayers = fLayers.size();
+  Double_t chi2 = 0;
+
+  for (Int_t direction : {1, -1})
+  {
+    const SeedPoint *last = (direction > 0 ? &p2 : &p0);
+    Int_t numMissing = 0;
+    for (Int_t layer = last->fLayer + direction; layer >= 0 && layer < numLayers; layer += direction)
+    {
+      auto idx = FindBestInLayer(layer, *last, circle, direction * tanDip, numMissing);
+      if (idx < 0)
+      {
+        if (++numMissing > fMaxMissingLayers)
+          break;
+        continue;
+      }
+
+      last = &fLayers[layer][idx];
+      points.push_back(last);
+      numMissing = 0;
+
+      Circle refit;
+      if (FitCircle(points, refit, chi2))
+        circle = refit;
+    }
+  }
+
+  FitCircle(points, circle, chi2);
+
+  seed.fTripletIndex = iTriplet;
+  seed.fRadius = circle.fR;
+  seed.fChi2 = chi2;
+  seed.fHits.clear();
+  for (auto point : points)
+    seed.fHits.push_back(point->fHit);
+}
+
+void LHHelixSeedFinder::ResolveConflicts(vector<LHHelixSeed> &candidates, vector<LHHelixSeed> &seeds) const
+{
+  vector<Int_t> order(candidates.size());
+  for (Int_t i = 0; i < Int_t(order.size()); ++i)
+    order[i] = i;
+
+  // longest first, then best fit, then triplet index so that ties never depend on the thread schedule
+  sort(order.begin(), order.end(), [&](Int_t a, Int_t b)
+       {
+         const auto &ca = candidates[a];
+         const auto &cb = candidates[b];
+         if (ca.fHits.size() != cb.fHits.size())
+           return ca.fHits.size() > cb.fHits.size();
+         if (ca.fChi2 != cb.fChi2)
+           return ca.fChi2 < cb.fChi2;
+         return ca.fTripletIndex < cb.fTripletIndex; });
+
+  unordered_set<KBTpcHit *> claimed;
+  for (auto idx : order)
+  {
+    auto &candidate = candidates[idx];
+    Int_t numHits = candidate.fHits.size();
+    if (numHits < fMinSeedHits)
+      continue;
+
+    Int_t numShared = 0;
+    for (auto hit : candidate.fHits)
+      if (claimed.count(hit))
+        ++numShared;
+
+    if (numShared > fMaxSharedFraction * numHits)
+      continue;
+
+    if (numHits - numShared < fMinSeedHits)
+      continue;
+
+    LHHelixSeed seed;
+    seed.fTripletIndex = candidate.fTripletIndex;
+    seed.fRadius = candidate.fRadius;
+    seed.fChi2 = candidate.fChi2;
+    for (auto hit : candidate.fHits)
+    {
+      if (claimed.insert(hit).second)
+        seed.fHits.push_back(hit);
+    }
+    seeds.push_back(seed);
+  }
+}
+
+bool LHHelixSeedFinder::CircleFrom3(const SeedPoint &p0, const SeedPoint &p1, const SeedPoint &p2, Circle &circle)
+{
+  auto d = 2 * (p0.fI * (p1.fJ - p2.fJ) + p1.fI * (p2.fJ - p0.fJ) + p2.fI * (p0.fJ - p1.fJ));
+  if (abs(d) < 1.e-9)
+  {
+    // collinear : treat as a circle with very large radius on the left side
+    auto di = p2.fI - p0.fI;
+    auto dj = p2.fJ - p0.fJ;
+    auto norm = sqrt(di * di + dj * dj);
+    if (norm == 0)
+      norm = 1;
+    circle.fR = 1.e7;
+    circle.fI = p1.fI - dj / norm * circle.fR;
+    circle.fJ = p1.fJ + di / norm * circle.fR;
+    return false;
+  }
+
+  auto s0 = p0.fI * p0.fI + p0.fJ * p0.fJ;
+  auto s1 = p1.fI * p1.fI + p1.fJ * p1.fJ;
+  auto s2 = p2.fI * p2.fI + p2.fJ * p2.fJ;
+
+  circle.fI = (s0 * (p1.fJ - p2.fJ) + s1 * (p2.fJ - p0.fJ) + s2 * (p0.fJ - p1.fJ)) / d;
+  circle.fJ = (s0 * (p2.fI - p1.fI) + s1 * (p0.fI - p2.fI) + s2 * (p1.fI - p0.fI)) / d;
+  auto di = p0.fI - circle.fI;
+  auto dj = p0.fJ - circle.fJ;
+  circle.fR = sqrt(di * di + dj * dj);
+
+  return true;
+}
+
+bool LHHelixSeedFinder::FitCircle(const vector<const SeedPoint *> &points, Circle &circle, Double_t &chi2)
+{
+  // algebraic (Kasa) fit : minimize sum (x^2 + y^2 + D x + E y + F)^2
+  Int_t numPoints = points.size();
+  if (numPoints < 3)
+    return false;
+
+  Double_t sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0, sz = 0, sxz = 0, syz = 0;
+  for (auto point : points)
+  {
+    auto x = point->fI;
+    auto y = point->fJ;
+    auto z = x * x + y * y;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    syy += y * y;
+    sxy += x * y;
+    sz += z;
+    sxz += x * z;
+    syz += y * z;
+  }
+
+  // | sxx sxy sx | |D|   | -sxz |
+  // | sxy syy sy | |E| = | -syz |
+  // | sx  sy  n  | |F|   | -sz  |
+  Double_t n = numPoints;
+  auto det = sxx * (syy * n - sy * sy) - sxy * (sxy * n - sy * sx) + sx * (sxy * sy - syy * sx);
+  if (abs(det) < 1.e-9)
+    return false;
+
+  auto detD = (-sxz) * (syy * n - sy * sy) - sxy * ((-syz) * n - sy * (-sz)) + sx * ((-syz) * sy - syy * (-sz));
+  auto detE = sxx * ((-syz) * n - (-sz) * sy) - (-sxz) * (sxy * n - sy * sx) + sx * (sxy * (-sz) - (-syz) * sx);
+  auto detF = sxx * (syy * (-sz) - (-syz) * sy) - sxy * (sxy * (-sz) - (-syz) * sx) + (-sxz) * (sxy * sy - syy * sx);
+
+  auto D = detD / det;
+  auto E = detE / det;
+  auto F = detF / det;
+
+  auto r2 = (D * D + E * E) / 4 - F;
+  if (r2 <= 0)
+    return false;
+
+  circle.fI = -D / 2;
+  circle.fJ = -E / 2;
+  circle.fR = sqrt(r2);
+
+  chi2 = 0;
+  for (auto point : points)
+  {
+    auto di = point->fI - circle.fI;
+    auto dj = point->fJ - circle.fJ;
+    auto residual = sqrt(di * di + dj * dj) - circle.fR;
+    chi2 += residual * residual;
+  }
+  chi2 = chi2 / numPoints;
+
+  return true;
+}
+
+Double_t LHHelixSeedFinder::ArcLength(const Circle &circle, const SeedPoint &p0, const SeedPoint &p1)
+{
+  auto di = p1.fI - p0.fI;
+  auto dj = p1.fJ - p0.fJ;
+  auto chord = sqrt(di * di + dj * dj);
+  if (circle.fR <= 0 || chord >= 2 * circle.fR)
+    return chord;
+
+  return 2 * circle.fR * asin(chord / (2 * circle.fR));
+}
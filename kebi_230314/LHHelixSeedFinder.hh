@@ -0,0 +1,101 @@
+#ifndef LHHELIXSEEDFINDER_HH
+#define LHHELIXSEEDFINDER_HH
+
+#include "TClonesArray.h"
+
+#include "KBTpcHit.hh"
+#include "KBVector3.hh"
+
+#include <array>
+#include <vector>
+using namespace std;
+
+/**
+ * Seed proposal stage for LHHelixTrackFindingTask.
+ *
+ * Hits are grouped by pad row (layer). Doublets are built between adjacent
+ * layers and joined into triplets (cellular automaton cells) when their
+ * direction, curvature and dip are compatible. Every triplet is then extended
+ * layer by layer with a circle fit on a read-only snapshot of the hits; this
+ * extension is independent per triplet and runs on a thread pool. A
+ * deterministic conflict-resolution pass finally keeps the best candidates so
+ * that the returned seeds do not share hits.
+ */
+struct LHHelixSeed
+{
+  vector<KBTpcHit *> fHits;
+  Double_t fChi2 = 0;      ///< mean squared circle residual [mm^2]
+  Double_t fRadius = 0;    ///< fitted radius in the pad plane
+  Int_t fTripletIndex = -1; ///< index of the triplet the seed was grown from
+};
+
+class LHHelixSeedFinder
+{
+public:
+  LHHelixSeedFinder() {}
+  virtual ~LHHelixSeedFinder() {}
+
+  void SetReferenceAxis(KBVector3::Axis axis) { fReferenceAxis = axis; }
+  void SetNumThreads(Int_t val) { fNumThreads = val; }
+
+  void SetCutDoubletDist(Double_t val) { fCutDoubletDist = val; }
+  void SetCutDoubletDk(Double_t val) { fCutDoubletDk = val; }
+  void SetCutTripletAngle(Double_t val) { fCutTripletAngle = val; }
+  void SetCutTripletDip(Double_t val) { fCutTripletDip = val; }
+  void SetCutMinHelixRadius(Double_t val) { fCutMinHelixRadius = val; }
+  void SetCutExtendResidual(Double_t val) { fCutExtendResidual = val; }
+  void SetMaxMissingLayers(Int_t val) { fMaxMissingLayers = val; }
+  void SetMinSeedHits(Int_t val) { fMinSeedHits = val; }
+  void SetMaxSharedFraction(Double_t val) { fMaxSharedFraction = val; }
+
+  Int_t GetMinSeedHits() const { return fMinSeedHits; }
+
+  /// Fill seeds from the free hits (no track candidate) in hitArray.
+  void FindSeeds(TClonesArray *hitArray, vector<LHHelixSeed> &seeds);
+  void FindSeeds(const vector<KBTpcHit *> &hits, vector<LHHelixSeed> &seeds);
+
+private:
+  struct SeedPoint
+  {
+    KBTpcHit *fHit;
+    Double_t fI, fJ, fK;
+    Double_t fPhi;
+    Int_t fLayer;
+  };
+
+  struct Circle
+  {
+    Double_t fI = 0, fJ = 0, fR = 0;
+  };
+
+  void BuildLayers(const vector<KBTpcHit *> &hits);
+  void FindTriplets();
+  void ExtendTriplet(Int_t iTriplet, LHHelixSeed &seed) const;
+  void ResolveConflicts(vector<LHHelixSeed> &candidates, vector<LHHelixSeed> &seeds) const;
+
+  void FindInPhiWindow(Int_t layer, Double_t phi, Double_t dphi, vector<Int_t> &found) const;
+  Int_t FindBestInLayer(Int_t layer, const SeedPoint &last, const Circle &circle, Double_t tanDip, Int_t numMissing) const;
+
+  static bool CircleFrom3(const SeedPoint &p0, const SeedPoint &p1, const SeedPoint &p2, Circle &circle);
+  static bool FitCircle(const vector<const SeedPoint *> &points, Circle &circle, Double_t &chi2);
+  static Double_t ArcLength(const Circle &circle, const SeedPoint &p0, const SeedPoint &p1);
+
+  KBVector3::Axis fReferenceAxis = KBVector3::kZ;
+  Int_t fNumThreads = 0; ///< 0 : use all hardware threads
+
+  Double_t fCutDoubletDist = 25.;    ///< max pad-plane distance between hits in adjacent layers
+  Double_t fCutDoubletDk = 25.;      ///< max drift-axis distance between hits in adjacent layers
+  Double_t fCutTripletAngle = 0.3;   ///< max turning angle between two doublets [rad]
+  Double_t fCutTripletDip = 0.3;     ///< max difference of dk/ds between two doublets
+  Double_t fCutMinHelixRadius = 30.; ///< same meaning as in LHHelixTrackFindingTask
+  Double_t fCutExtendResidual = 6.;  ///< max circle residual of an extension hit
+  Int_t fMaxMissingLayers = 2;       ///< stop extension after this number of empty layers
+  Int_t fMinSeedHits = 5;            ///< drop seeds with fewer hits after conflict resolution
+  Double_t fMaxSharedFraction = 0.3; ///< drop candidates sharing more than this fraction of hits
+
+  vector<vector<SeedPoint>> fLayers; ///< hits per layer, sorted in phi
+  vector<array<Int_t, 6>> fTriplets; ///< (layer, index) x 3
+  Int_t fLayerOffset = 0;
+};
+
+#endif
@@ -1,42 +1,71 @@
 #include "KBRun.hh"
+#include "LHRunContext.hh"
 #include "LHHelixTrackFindingTask.hh"
+#include "LHParallelFor.hh"
+#include "LHAllocationCounter.hh"
 
-#include <iostream>
+#include "TROOT.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
 
-// #define DEBUG_STEP
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <chrono>
+
+/// kb_debug output of the step machine is compiled out unless LH_HTF_DEBUG is defined
+// #define LH_HTF_DEBUG
+#ifdef LH_HTF_DEBUG
+#define lh_debug kb_debug
+#else
+#define lh_debug \
+  while (false)  \
+  kb_debug
+#endif
 #define FT
 
+static const char *kStepNames[] = {"InitArray", "NewTrack", "RemoveTrack", "InitTrack", "InitTrackAddHit", "Continuum", "ContinuumAddHit",
+                                   "Extrapolation", "ExtrapolationAddHit", "Confirmation", "FinalizeTrack", "NextPhase", "EndEvent", "EndOfEvent"};
+static const char *kRemoveReasonNames[] = {"no candhit", "cutmaxnumhits", "extrapolation", "confirmation 1", "confirmation 2"};
+
 ClassImp(LHHelixTrackFindingTask)
 
+LHHelixTrackFindingTask::~LHHelixTrackFindingTask()
+{
+  // closing the writer flushes the records of the last buffer
+  delete fStepTrace;
+  delete fFitter;
+  for (auto worker : fSectorTasks)
+    delete worker;
+}
+
     bool LHHelixTrackFindingTask::Init()
 {
   auto run = KBRun::GetRun();
   fPar = run->GetParameterContainer();
-  fTpc = (LHTpc *)(run->GetDetectorSystem()->GetTpc());
+  fTpc = LHRunContext::GetTpc();
   // FTDetector = (KBFTDetector *)(run->GetDetectorSystem()->GetTpc());
   fPadPlane = (KBPadPlane *)fTpc->GetPadPlane();
   // FTPad = (KBPadPlane *)FTDetector->GetPadPlane();
 
-  fHitArray = (TClonesArray *)run->GetBranch(fBranchNameHit);
-#ifdef FT
-  fHitArray_FT = (TClonesArray *)run->GetBranch(fBranchNameHit_FT);
-#endif
+  fHitArray = (TClonesArray *)LHRunContext::GetBranch(fBranchNameHit);
 
+  fFitter = new KBHelixTrackFitter();
   fTrackArray = new TClonesArray("KBHelixTrack");
-  run->RegisterBranch(fBranchNameTracklet, fTrackArray, fPersistency);
+  LHRunContext::RegisterBranch(fBranchNameTracklet, fTrackArray, fPersistency && !fUseCompactPersistency);
+  if (fUseCompactPersistency)
+  {
+    fCompactTrackArray = new TClonesArray("LHCompactTrack");
+    LHRunContext::RegisterBranch(fBranchNameCompactTracklet, fCompactTrackArray, fPersistency);
+  }
 
-  fTrackHits = new KBHitArray();
-  fCandHits = new KBHitArray();
-  fCandHits_FT = new KBHitArray();
-  fGoodHits = new KBHitArray();
-  fGoodHits_FT = new KBHitArray();
-  fBadHits = new KBHitArray();
-  fBadHits_FT = new KBHitArray();
+  CreateHitArrays();
 
-  run->RegisterBranch("TrackHit", fTrackHits, false);
-  run->RegisterBranch("CandHit", fCandHits, false);
-  run->RegisterBranch("GoodHit", fGoodHits, false);
-  run->RegisterBranch("BadHit", fBadHits, false);
+  LHRunContext::RegisterBranch("TrackHit", fTrackHits, false);
+  LHRunContext::RegisterBranch("CandHit", fCandHits, false);
+  LHRunContext::RegisterBranch("GoodHit", fGoodHits, false);
+  LHRunContext::RegisterBranch("BadHit", fBadHits, false);
 
   fDefaultScale = fPar->GetParDouble("LHTF_defaultScale");
   fTrackWCutLL = fPar->GetParDouble("LHTF_trackWCutLL");
@@ -45,13 +74,80 @@ ClassImp(LHHelixTrackFindingTask)
   fTrackHCutHL = fPar->GetParDouble("LHTF_trackHCutHL");
   fReferenceAxis = fPar->GetParAxis("LHTF_refAxis");
 
+  if (fUseSeeding)
+  {
+    fSeedFinder = new LHHelixSeedFinder();
+    fSeedFinder->SetReferenceAxis(fReferenceAxis);
+    fSeedFinder->SetNumThreads(fNumSeedingThreads);
+    fSeedFinder->SetCutMinHelixRadius(fCutMinHelixRadius);
+  }
+
+  fSplitTrackMerger.SetReferenceAxis(fReferenceAxis);
+
+#ifdef FT
+  fHitArray_FT = (TClonesArray *)LHRunContext::GetBranch(fBranchNameHit_FT);
+  if (fUseFTMatching && fHitArray_FT != nullptr)
+  {
+    fFTMatcher = new LHFTTrackMatcher();
+    fFTMatcher->SetReferenceAxis(fReferenceAxis);
+    fFTMatchArray = new TClonesArray("LHFTAssociation");
+    LHRunContext::RegisterBranch(fBranchNameFTMatch, fFTMatchArray, fPersistency);
+  }
+#endif
+
+  if (fPhases.empty())
+  {
+    LHHelixTrackFindingPhase phase0;
+    LHHelixTrackFindingPhase phase1;
+    phase1.fCutMaxNumHitsInitTrack = 25;
+    fPhases.push_back(phase0);
+    fPhases.push_back(phase1);
+  }
+
+  if (fNumSectors > 1)
+    InitSectorWorkers();
+
+  if (!fStepTraceFileName.IsNull())
+  {
+    if (fNumSectors > 1)
+      kb_warning << "Step trace is not recorded in phi-sector mode" << endl;
+    else
+    {
+      fStepTrace = new LHStepTraceWriter();
+      if (!fStepTrace->Open(fStepTraceFileName))
+      {
+        kb_error << "Cannot open step trace file " << fStepTraceFileName << endl;
+        delete fStepTrace;
+        fStepTrace = nullptr;
+      }
+    }
+  }
+
   fNextStep = StepNo::kStepInitArray;
 
   return true;
 }
 
+void LHHelixTrackFindingTask::CreateHitArrays()
+{
+  fTrackHits = new KBHitArray();
+  fCandHits = new KBHitArray();
+  fGoodHits = new KBHitArray();
+  fBadHits = new KBHitArray();
+  fSeedHits = new KBHitArray();
+
+  for (auto hitArray : {fTrackHits, fCandHits, fGoodHits, fBadHits, fSeedHits})
+    hitArray->Expand(fHitArrayCapacity);
+}
+
 void LHHelixTrackFindingTask::Exec(Option_t *)
 {
+  if (fNumSectors > 1)
+  {
+    ExecSectors();
+    return;
+  }
+
   fNextStep = StepNo::kStepInitArray;
   while (ExecStep())
   {
@@ -62,35 +158,177 @@ bool LHHelixTrackFindingTask::ExecStep()
 {
   if (fNextStep == kStepEndOfEvent)
     return false;
-  else if (fNextStep == kStepInitArray)
-    fNextStep = StepInitArray();
-  else if (fNextStep == kStepNewTrack)
-    fNextStep = StepNewTrack();
-  else if (fNextStep == kStepRemoveTrack)
-    fNextStep = StepRemoveTrack();
-  else if (fNextStep == kStepInitTrack)
-    fNextStep = StepInitTrack();
-  else if (fNextStep == kStepInitTrackAddHit)
-    fNextStep = StepInitTrackAddHit();
-  else if (fNextStep == kStepContinuum)
-    fNextStep = StepContinuum();
-  else if (fNextStep == kStepContinuumAddHit)
-    fNextStep = StepContinuumAddHit();
-  else if (fNextStep == kStepExtrapolation)
-    fNextStep = StepExtrapolation();
-  else if (fNextStep == kStepExtrapolationAddHit)
-    fNextStep = StepExtrapolationAddHit();
-  else if (fNextStep == kStepConfirmation)
-    fNextStep = StepConfirmation();
-  else if (fNextStep == kStepFinalizeTrack)
-    fNextStep = StepFinalizeTrack();
-  else if (fNextStep == kStepNextPhase)
-    fNextStep = StepNextPhase();
-  else if (fNextStep == kStepEndEvent)
-    fNextStep = StepEndEvent();
+
+  Int_t step = fNextStep;
+  fRunningStep = step;
+  if (fUseStepTiming)
+  {
+    auto start = chrono::steady_clock::now();
+    fNextStep = DispatchStep(step);
+    fStepTimes[step] += chrono::duration<Double_t>(chrono::steady_clock::now() - start).count();
+  }
+  else
+    fNextStep = DispatchStep(step);
+
+  ++fStepCounts[step];
+  ++fStepTransitions[step][fNextStep];
+  if (fStepTrace != nullptr)
+  {
+    Trace(LHStepTraceRecord::kTraceStep, step, fNextStep, fCandHits->GetEntriesFast());
+    // the event ends after the record of its last step, with the tracks left after merging and FT matching
+    if (fNextStep == kStepEndOfEvent)
+    {
+      fStepTrace->Add(LHStepTraceRecord::kTraceEventEnd, kStepEndEvent, kStepEndOfEvent, fPhaseIndex, -1, fTrackArray->GetEntriesFast());
+      fStepTrace->Flush();
+    }
+  }
   return true;
 }
 
+int LHHelixTrackFindingTask::DispatchStep(Int_t step)
+{
+  switch (step)
+  {
+  case kStepInitArray:
+    return StepInitArray();
+  case kStepNewTrack:
+    return StepNewTrack();
+  case kStepRemoveTrack:
+    return StepRemoveTrack();
+  case kStepInitTrack:
+    return StepInitTrack();
+  case kStepInitTrackAddHit:
+    return StepInitTrackAddHit();
+  case kStepContinuum:
+    return StepContinuum();
+  case kStepContinuumAddHit:
+    return StepContinuumAddHit();
+  case kStepExtrapolation:
+    return StepExtrapolation();
+  case kStepExtrapolationAddHit:
+    return StepExtrapolationAddHit();
+  case kStepConfirmation:
+    return StepConfirmation();
+  case kStepFinalizeTrack:
+    return StepFinalizeTrack();
+  case kStepNextPhase:
+    return StepNextPhase();
+  case kStepEndEvent:
+    return StepEndEvent();
+  }
+  return kStepEndOfEvent;
+}
+
+int LHHelixTrackFindingTask::RemoveTrack(RemoveReason reason)
+{
+  ++fNumRemovedTracks[reason];
+  if (fStepTrace != nullptr)
+    Trace(LHStepTraceRecord::kTraceTrackRemoved, reason, kStepRemoveTrack, fCurrentTrack->GetNumHits());
+  lh_debug << kRemoveReasonNames[reason] << " remove!!" << endl;
+  return kStepRemoveTrack;
+}
+
+void LHHelixTrackFindingTask::Trace(UChar_t type, Int_t step, Int_t nextStep, Int_t value)
+{
+  Int_t trackID = fCurrentTrack != nullptr ? fCurrentTrack->GetTrackID() : -1;
+  fStepTrace->Add(type, step, nextStep, fPhaseIndex, trackID, value);
+}
+
+void LHHelixTrackFindingTask::AddHitToTrack(KBHelixTrack *track, KBHit *hit)
+{
+  track->AddHit(hit);
+  InvalidateHelixFrame();
+  if (fStepTrace != nullptr)
+    Trace(LHStepTraceRecord::kTraceHitAdded, fRunningStep, fRunningStep, hit->GetHitID());
+}
+
+void LHHelixTrackFindingTask::ResetStepCounters()
+{
+  for (Int_t step = 0; step < kStepEndOfEvent; ++step)
+  {
+    fStepCounts[step] = 0;
+    fStepTimes[step] = 0;
+    fStepNumPulledHits[step] = 0;
+    for (Int_t next = 0; next <= kStepEndOfEvent; ++next)
+      fStepTransitions[step][next] = 0;
+  }
+  for (Int_t reason = 0; reason < kNumRemoveReasons; ++reason)
+    fNumRemovedTracks[reason] = 0;
+
+  for (auto worker : fSectorTasks)
+    worker->ResetStepCounters();
+}
+
+bool LHHelixTrackFindingTask::EndOfRun()
+{
+  auto file = KBRun::GetRun()->GetOutputFile();
+  if (file != nullptr && file->IsOpen())
+    WriteStepHistograms(file);
+  return true;
+}
+
+void LHHelixTrackFindingTask::WriteStepHistograms(TDirectory *directory)
+{
+  if (directory == nullptr)
+  {
+    kb_error << "No directory to write the step histograms" << endl;
+    return;
+  }
+
+  auto histCount = new TH1D("HTFStepCount", "number of executions;step;count", kStepEndOfEvent, 0, kStepEndOfEvent);
+  auto histTime = new TH1D("HTFStepTime", "time spent in step;step;time [ms]", kStepEndOfEvent, 0, kStepEndOfEvent);
+  auto histPulled = new TH1D("HTFStepPulledHits", "hits pulled out of the pad plane;step;hits", kStepEndOfEvent, 0, kStepEndOfEvent);
+  auto histTransition = new TH2D("HTFStepTransition", "step transitions;step;next step", kStepEndOfEvent, 0, kStepEndOfEvent, kStepEndOfEvent + 1, 0, kStepEndOfEvent + 1);
+  auto histRemoved = new TH1D("HTFRemovedTracks", "removed tracks;reason;tracks", kNumRemoveReasons, 0, kNumRemoveReasons);
+
+  // sector workers keep their own counters
+  vector<LHHelixTrackFindingTask *> tasks = {this};
+  tasks.insert(tasks.end(), fSectorTasks.begin(), fSectorTasks.end());
+
+  for (Int_t step = 0; step < kStepEndOfEvent; ++step)
+  {
+    Double_t count = 0, time = 0, pulled = 0;
+    for (auto task : tasks)
+    {
+      count += task->fStepCounts[step];
+      time += task->fStepTimes[step];
+      pulled += task->fStepNumPulledHits[step];
+    }
+    histCount->SetBinContent(step + 1, count);
+    histTime->SetBinContent(step + 1, 1000 * time);
+    histPulled->SetBinContent(step + 1, pulled);
+
+    for (Int_t next = 0; next <= kStepEndOfEvent; ++next)
+    {
+      Double_t transitions = 0;
+      for (auto task : tasks)
+        transitions += task->fStepTransitions[step][next];
+      histTransition->SetBinContent(step + 1, next + 1, transitions);
+    }
+
+    for (auto hist : {(TH1 *)histCount, (TH1 *)histTime, (TH1 *)histPulled, (TH1 *)histTransition})
+      hist->GetXaxis()->SetBinLabel(step + 1, kStepNames[step]);
+  }
+  for (Int_t next = 0; next <= kStepEndOfEvent; ++next)
+    histTransition->GetYaxis()->SetBinLabel(next + 1, kStepNames[next]);
+
+  for (Int_t reason = 0; reason < kNumRemoveReasons; ++reason)
+  {
+    Double_t removed = 0;
+    for (auto task : tasks)
+      removed += task->fNumRemovedTracks[reason];
+    histRemoved->SetBinContent(reason + 1, removed);
+    histRemoved->GetXaxis()->SetBinLabel(reason + 1, kRemoveReasonNames[reason]);
+  }
+
+  TDirectory::TContext context(directory);
+  for (auto hist : {(TH1 *)histCount, (TH1 *)histTime, (TH1 *)histPulled, (TH1 *)histTransition, (TH1 *)histRemoved})
+  {
+    hist->Write();
+    delete hist;
+  }
+}
+
 bool LHHelixTrackFindingTask::ExecStepUptoTrackNum(Int_t numTracks)
 {
   if (fNextStep == kStepEndOfEvent)
@@ -107,26 +345,52 @@ bool LHHelixTrackFindingTask::ExecStepUptoTrackNum(Int_t numTracks)
 
 int LHHelixTrackFindingTask::StepInitArray()
 {
+  fNumAllocationsAtEventStart = LHAllocationCounter::GetCount();
   fCurrentTrack = nullptr;
 
   fPhaseIndex = 0;
+  if (fStepTrace != nullptr)
+    Trace(LHStepTraceRecord::kTraceEventBegin, kStepInitArray, kStepInitArray, LHRunContext::GetEventID());
+  ApplyPhase(0);
+  fPhaseTimes.assign(fPhases.size(), 0.);
+  fPhaseNumTracks.assign(fPhases.size(), 0);
+  fNumTracksBeforePhase = 0;
+  fPhaseStopwatch.Start(kTRUE);
+
+  ResetPadPlaneHitMap();
+  if (fIsSectorWorker)
+  {
+    // overlap hits of tracks removed by a neighbouring sector only carry -1 candidates and are offered again
+    for (auto hit : fSectorHits)
+    {
+      if (CheckParentTrackID(hit) >= 0)
+        continue;
+      ClearRemovedTrackCands(hit);
+      AddHitToPadPlane(hit);
+    }
+  }
+  else if (fUseSparsePadReset)
+  {
+    Int_t numHits = fHitArray->GetEntriesFast();
+    for (Int_t iHit = 0; iHit < numHits; ++iHit)
+      AddHitToPadPlane((KBTpcHit *)fHitArray->At(iHit));
+  }
+  else
+    fPadPlane->SetHitArray(fHitArray);
 
-  fPadPlane->ResetHitMap();
-  fPadPlane->SetHitArray(fHitArray);
+  if (fUseAnalyticStepping)
+    BuildPopulatedRowRadii();
 
   fTrackArray->Clear("C");
   fTrackHits->Clear();
   fCandHits->Clear();
-  // fCandHits_FT -> Clear();
   fGoodHits->Clear();
-  fGoodHits_FT->Clear();
   fBadHits->Clear();
-  fBadHits_FT->Clear();
 
-  if (firstinit)
+  if (fUseSeeding)
   {
-    cnt = 0;
-    firstinit = false;
+    FindSeeds();
+    lh_debug << "[seeds] :: " << fSeeds.size() << endl;
   }
 
   return kStepNewTrack;
@@ -141,42 +405,45 @@ int LHHelixTrackFindingTask::StepNewTrack()
   fTrackHits->Clear();
   fCandHits->Clear();
   fGoodHits->Clear();
-  fGoodHits_FT->Clear();
   ReturnBadHitsToPadPlane();
 
-  KBTpcHit *hit = fPadPlane->PullOutNextFreeHit();
-  if (hit == nullptr)
+  if (!fUseSeeding || !PullOutNextSeed(fSeedHits))
   {
-    return kStepNextPhase;
+    KBTpcHit *hit = PullOutNextFreeHit();
+    if (hit == nullptr)
+    {
+      return kStepNextPhase;
+    }
+    ++fStepNumPulledHits[fRunningStep];
+    fSeedHits->AddHit(hit);
   }
 
+  // reuse the track objects kept by fTrackArray from earlier events
   Int_t idx = fTrackArray->GetEntries();
-  fCurrentTrack = new ((*fTrackArray)[idx]) KBHelixTrack(idx);
+  fCurrentTrack = (KBHelixTrack *)fTrackArray->ConstructedAt(idx, "C");
+  fCurrentTrackIndex = idx;
+  InvalidateHelixFrame(); // the reused object may be the cached one
+  fCurrentTrack->SetTrackID(fTrackIDOffset + idx);
   fCurrentTrack->SetReferenceAxis(fReferenceAxis);
-  fCurrentTrack->AddHit(hit);
-  fGoodHits->AddHit(hit);
-#ifdef FT
-  if (cnt == 0)
+  Int_t numSeedHits = fSeedHits->GetEntriesFast();
+  for (Int_t iSeedHit = 0; iSeedHit < numSeedHits; ++iSeedHit)
   {
-    for (int i = 0; i < fHitArray_FT->GetEntries(); i++)
-    {
-      auto hit_FT = (KBHit *)fHitArray_FT->At(i);
-      fGoodHits_FT->AddHit(hit_FT);
-    }
-    cnt++;
-    kb_debug << "[hits in FT] :: " << fGoodHits_FT->GetNumHits() << endl;
+    auto hit = (KBTpcHit *)fSeedHits->GetHit(iSeedHit);
+    AddHitToTrack(fCurrentTrack, hit);
+    fGoodHits->AddHit(hit);
   }
+  fSeedHits->Clear();
+  // kb_debug << "[NewTrack : ] " << hit->GetPadID() << "\t" << fGoodHits -> GetNumHits()<< endl;
 
-  for (int i = 0; i < fBadHits_FT->GetEntries(); i++)
+  if (numSeedHits >= fMinHitsToFitInitTrack)
   {
-    auto usedhit_FT = (KBHit *)fBadHits_FT->At(i);
-    // fCurrentTrack->AddHit(usedhit_FT); // quality check 필요;
-    fGoodHits_FT->AddHit(usedhit_FT);
+    FitTrack(fCurrentTrack);
+    if (CheckInitTrackIsHelix(fCurrentTrack))
+      return kStepContinuum;
+    FitTrackPlane(fCurrentTrack);
   }
-  kb_debug << "[hits new track] :: " << fBadHits_FT->GetNumHits() << endl;
-  fBadHits_FT->Clear();
-#endif
-  // kb_debug << "[NewTrack : ] " << hit->GetPadID() << "\t" << fGoodHits -> GetNumHits()<< endl;
+  else if (numSeedHits > 1)
+    FitTrackPlane(fCurrentTrack);
 
   return kStepInitTrack;
 }
@@ -193,17 +460,14 @@ int LHHelixTrackFindingTask::StepRemoveTrack()
   for (Int_t iTrackHit = 0; iTrackHit < numTrackHits; ++iTrackHit)
   {
     auto trackHit = (KBTpcHit *)trackHits->GetHit(iTrackHit);
-    if (trackHit->GetHitID() >= 40000) // FT hit selection ..?
-    {                                  // continue
-      continue;
-    }
     trackHit->AddTrackCand(-1);
-    fPadPlane->AddHit(trackHit);
+    AddHitToPadPlane(trackHit);
   }
-  fTrackArray->Remove(fCurrentTrack);
+  // RemoveAt keeps the memory of the track in fTrackArray and Compress moves it behind the last track,
+  // where the next ConstructedAt takes it again
+  fTrackArray->RemoveAt(fCurrentTrackIndex);
+  fTrackArray->Compress();
   fCurrentTrack = nullptr;
-  kb_debug << "[hits remove track ] :: " << fBadHits_FT->GetNumHits() << endl;
-  firstinit = true;
   return kStepNewTrack;
 }
 
@@ -219,24 +483,21 @@ int LHHelixTrackFindingTask::StepInitTrack()
 {
   // kb_debug << "[Init :: ]"<<fGoodHits -> GetNumHits() << endl;
   fCandHits->Clear();
-  fPadPlane->PullOutNeighborHits(fGoodHits, fCandHits);
-  // kb_debug << "[candhit :: ] " << fCandHits->GetNumHits() << endl;
+  PullOutNeighborHits(fGoodHits, fCandHits);
   fGoodHits->MoveHitsTo(fTrackHits);
   fNumCandHits = fCandHits->GetEntriesFast();
+  fStepNumPulledHits[fRunningStep] += fNumCandHits;
   if (fNumCandHits == 0)
-  {
-    kb_debug << "no candhit remove!!" << endl;
-    return kStepRemoveTrack;
-  }
-  fCandHits->SortByDistanceTo(fCurrentTrack->GetMean(), true);
+    return RemoveTrack(kRemoveNoCandHit);
+  fCandHeap.OrderByDistanceTo(fCurrentTrack->GetMean(), true);
+  fCandHeap.Build(fCandHits);
   return kStepInitTrackAddHit;
 }
 
 int LHHelixTrackFindingTask::StepInitTrackAddHit()
 {
   // kb_debug << "here " << endl;
-  auto candHit = (KBTpcHit *)fCandHits->GetLastHit();
-  fCandHits->RemoveLastHit();
+  auto candHit = fCandHeap.PopHit(fCandHits);
 
   Double_t quality;
 
@@ -248,8 +509,8 @@ int LHHelixTrackFindingTask::StepInitTrackAddHit()
   if (quality > 0)
   {
     fGoodHits->AddHit(candHit);
-    fCurrentTrack->AddHit(candHit);
-    fCurrentTrack->FitPlane(); // XXX should comment out
+    AddHitToTrack(fCurrentTrack, candHit);
+    FitTrackPlane(fCurrentTrack); // XXX should comment out
 
     auto numHitsInTrack = fCurrentTrack->GetNumHits();
 
@@ -258,27 +519,24 @@ int LHHelixTrackFindingTask::StepInitTrackAddHit()
       Int_t numCandHits2 = fCandHits->GetEntriesFast();
       for (Int_t iCand = 0; iCand < numCandHits2; ++iCand)
       {
-        fPadPlane->AddHit((KBTpcHit *)fCandHits->GetHit(iCand));
+        AddHitToPadPlane((KBTpcHit *)fCandHits->GetHit(iCand));
       }
 
       fCandHits->Clear("C");
 
-      kb_debug << "cutmaxnumhits remove!!" << endl;
-      return kStepRemoveTrack;
+      return RemoveTrack(kRemoveCutMaxNumHits);
     }
 
     if (numHitsInTrack >= fMinHitsToFitInitTrack)
     {
-      fCurrentTrack->Fit();
-      if (numHitsInTrack > fCutMinNumHitsInitTrack &&
-          fCurrentTrack->GetHelixRadius() > fCutMinHelixRadius &&
-          fCurrentTrack->TrackLength() > fTrackLengthCutScale * fCurrentTrack->GetRMST())
+      FitTrack(fCurrentTrack);
+      if (CheckInitTrackIsHelix(fCurrentTrack))
       {
         return kStepContinuum;
       }
       else
       {
-        fCurrentTrack->FitPlane();
+        FitTrackPlane(fCurrentTrack);
       }
     }
   }
@@ -301,22 +559,19 @@ int LHHelixTrackFindingTask::StepInitTrackAddHit()
 
 int LHHelixTrackFindingTask::StepContinuum()
 {
-  fPadPlane->PullOutNeighborHits(fGoodHits, fCandHits);
+  PullOutNeighborHits(fGoodHits, fCandHits);
   fGoodHits->MoveHitsTo(fTrackHits);
 
-#ifdef FT
-  fGoodHits_FT->MoveHitsTo(fCandHits_FT);
-
-  auto fNumCandHits_FT = fCandHits_FT->GetEntries();
-#endif
-
   fNumCandHits = fCandHits->GetEntries();
-  if (fNumCandHits == 0 && fNumCandHits_FT == 0) /// modified for FT.
+  fStepNumPulledHits[fRunningStep] += fNumCandHits;
+  if (fNumCandHits == 0)
   {
     return kStepExtrapolation;
   }
 
-  fCandHits->SortByCharge(false);
+  // hits left from the init stage and the new neighbours are merged into the heap
+  fCandHeap.OrderByCharge(false);
+  fCandHeap.Update(fCandHits);
   return kStepContinuumAddHit;
 }
 
@@ -324,8 +579,7 @@ int LHHelixTrackFindingTask::StepContinuumAddHit()
 {
   for (Int_t iHit = 0; iHit < fNumCandHits; iHit++)
   {
-    KBTpcHit *candHit = (KBTpcHit *)fCandHits->GetLastHit();
-    fCandHits->RemoveLastHit();
+    KBTpcHit *candHit = fCandHeap.PopHit(fCandHits);
 
     Double_t quality = 0;
     if (CheckParentTrackID(candHit) == -2)
@@ -334,8 +588,8 @@ int LHHelixTrackFindingTask::StepContinuumAddHit()
     if (quality > 0)
     {
       fGoodHits->AddHit(candHit);
-      fCurrentTrack->AddHit(candHit);
-      fCurrentTrack->Fit();
+      AddHitToTrack(fCurrentTrack, candHit);
+      FitTrack(fCurrentTrack);
     }
     else
     {
@@ -343,27 +597,6 @@ int LHHelixTrackFindingTask::StepContinuumAddHit()
     }
   }
 
-#ifdef FT
-  for (Int_t iHit = 0; iHit < fCandHits_FT->GetEntries(); iHit++)
-  {
-    KBTpcHit *candHit_FT = (KBTpcHit *)fCandHits_FT->GetLastHit();
-    fCandHits_FT->RemoveLastHit(); // sort 해야하는지 추후에 고민 할 것
-
-    Double_t quality = 0;
-    if (CheckParentTrackID(candHit_FT) == -2)
-      quality = CorrelateHitWithTrack(fCurrentTrack, candHit_FT);
-    if (quality > 0)
-    {
-      fCurrentTrack->AddHit(candHit_FT); //
-      fCurrentTrack->Fit();
-    }
-    else
-    {
-      fBadHits_FT->AddHit(candHit_FT); //
-    }
-  }
-
-#endif
   return kStepContinuum;
 }
 
@@ -406,8 +639,7 @@ int LHHelixTrackFindingTask::StepExtrapolationAddHit()
   {
     return kStepConfirmation;
   }
-  kb_debug << "extra polation remove!!" << endl;
-  return kStepRemoveTrack;
+  return RemoveTrack(kRemoveExtrapolation);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -427,19 +659,13 @@ int LHHelixTrackFindingTask::StepConfirmation()
   ReturnBadHitsToPadPlane();
 
   if (BuildAndConfirmTrack(fCurrentTrack, tailToHead) == false)
-  {
-    kb_debug << "confirmation remove 1!!" << endl;
-    return kStepRemoveTrack;
-  }
+    return RemoveTrack(kRemoveConfirmation1);
 
   tailToHead = !tailToHead;
 
   ReturnBadHitsToPadPlane();
   if (BuildAndConfirmTrack(fCurrentTrack, tailToHead) == false)
-  {
-    kb_debug << "confirmation remove 2!!" << endl;
-    return kStepRemoveTrack;
-  }
+    return RemoveTrack(kRemoveConfirmation2);
   ReturnBadHitsToPadPlane();
 
   return kStepFinalizeTrack;
@@ -451,54 +677,265 @@ int LHHelixTrackFindingTask::StepFinalizeTrack() // 정리
   Int_t trackID = fCurrentTrack->GetTrackID();
   Int_t numTrackHits = trackHits->GetNumHits();
   for (Int_t iTrackHit = 0; iTrackHit < numTrackHits; ++iTrackHit)
-  { // tpc Hit만 cand에 넣음
+  {
     auto trackHit = (KBTpcHit *)trackHits->GetHit(iTrackHit);
-    if (trackHit->GetHitID() >= 40000) // FT hit selection ..?
-    {                                  // continue
-      continue;
-    }
     trackHit->AddTrackCand(trackID);
-    fPadPlane->AddHit(trackHit);
+    AddHitToPadPlane(trackHit);
   } //
   fGoodHits->MoveHitsTo(fTrackHits);
   fGoodHits->Clear();
-  fGoodHits_FT->Clear();
-  firstinit = true;
-  kb_debug << "[hits finalize track] :: " << fBadHits_FT->GetNumHits() << endl;
+  if (fStepTrace != nullptr)
+    Trace(LHStepTraceRecord::kTraceTrackFinalized, kStepFinalizeTrack, kStepNewTrack, numTrackHits);
   return kStepNewTrack;
 }
 
 int LHHelixTrackFindingTask::StepNextPhase()
 {
-  if (fPhaseIndex == 0)
+  EndPhase();
+
+  if (fPhaseIndex + 1 >= Int_t(fPhases.size()))
+    return kStepEndEvent;
+
+  ++fPhaseIndex;
+  ApplyPhase(fPhaseIndex);
+
+  fTrackHits->Clear();
+  fCandHits->Clear();
+  fGoodHits->Clear();
+  ReturnBadHitsToPadPlane();
+
+  if (fPhases[fPhaseIndex].fLeftoverHitsOnly)
+    RefillPadPlaneWithLeftoverHits();
+  else
+    ResetPadPlaneEvent();
+
+  if (fUseSeeding)
+    FindSeeds();
+
+  fPhaseStopwatch.Start(kTRUE);
+
+  return kStepNewTrack;
+}
+
+void LHHelixTrackFindingTask::ApplyPhase(Int_t phaseIndex)
+{
+  auto &phase = fPhases[phaseIndex];
+  fMinHitsToFitInitTrack = phase.fMinHitsToFitInitTrack;
+  fCutMinNumHitsInitTrack = phase.fCutMinNumHitsInitTrack;
+  fCutMaxNumHitsInitTrack = phase.fCutMaxNumHitsInitTrack;
+  fCutMinNumHitsFinalTrack = phase.fCutMinNumHitsFinalTrack;
+  fCutMinHelixRadius = phase.fCutMinHelixRadius;
+  fTrackLengthCutScale = phase.fTrackLengthCutScale;
+  fCutdkInExpectedTrackPath = phase.fCutdkInExpectedTrackPath;
+}
+
+void LHHelixTrackFindingTask::EndPhase()
+{
+  fPhaseTimes[fPhaseIndex] = fPhaseStopwatch.RealTime();
+
+  Int_t numTracks = fTrackArray->GetEntries();
+  fPhaseNumTracks[fPhaseIndex] = numTracks - fNumTracksBeforePhase;
+  fNumTracksBeforePhase = numTracks;
+}
+
+void LHHelixTrackFindingTask::AddHitToPadPlane(KBTpcHit *hit)
+{
+  fPadPlane->AddHit(hit);
+  if (fUseSparsePadReset)
+    MarkPadDirty(hit->GetPadID());
+}
+
+void LHHelixTrackFindingTask::MarkPadDirty(Int_t padID)
+{
+  if (padID < 0)
+    return;
+  if (padID >= Int_t(fIsPadDirty.size()))
+    fIsPadDirty.resize(padID + 1, false);
+  if (fIsPadDirty[padID])
+    return;
+
+  fIsPadDirty[padID] = true;
+  if (!fDirtyPadIDs.empty() && padID < fDirtyPadIDs.back())
+    fDirtyPadsSorted = false;
+  fDirtyPadIDs.push_back(padID);
+}
+
+void LHHelixTrackFindingTask::PullOutNeighborHits(KBHitArray *hits, KBHitArray *neighborHits)
+{
+  fPadPlane->PullOutNeighborHits(hits, neighborHits);
+  if (!fUseSparsePadReset)
+    return;
+
+  Int_t numHits = hits->GetNumHits();
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+    MarkGrabbedPadsDirty(((KBTpcHit *)hits->GetHit(iHit))->GetPadID(), 1);
+}
+
+void LHHelixTrackFindingTask::PullOutNeighborHits(Double_t i, Double_t j, Int_t range, KBHitArray *neighborHits)
+{
+  fPadPlane->PullOutNeighborHits(i, j, range, neighborHits);
+  if (fUseSparsePadReset)
+    MarkGrabbedPadsDirty(fPadPlane->FindPadID(i, j), range + 1);
+}
+
+void LHHelixTrackFindingTask::MarkGrabbedPadsDirty(Int_t padID, Int_t depth)
+{
+  // the pad plane grabs every neighbour pad it visits, also the ones without hits,
+  // so the grabbed pads within depth neighbour rings are added to the dirty pads to be let go
+  if (padID < 0)
+    return;
+
+  // a pad is visited once per call : its mark is set to the generation of the call
+  if (fPadScanMarks.empty())
+    fPadScanMarks.assign(fPadPlane->GetNumPads(), 0);
+  if (++fPadScanGeneration == 0)
   {
-    fPhaseIndex = 1;
+    fPadScanMarks.assign(fPadScanMarks.size(), 0);
+    fPadScanGeneration = 1;
+  }
 
+  fGrabScanPads.clear();
+  fGrabScanPads.push_back(fPadPlane->GetPad(padID));
+  fPadScanMarks[padID] = fPadScanGeneration;
+  size_t ringBegin = 0;
+  for (Int_t iRing = 0; iRing <= depth; ++iRing)
+  {
+    size_t ringEnd = fGrabScanPads.size();
+    for (size_t iPad = ringBegin; iPad < ringEnd; ++iPad)
+    {
+      auto pad = fGrabScanPads[iPad];
+      if (pad->IsGrabed())
+        MarkPadDirty(pad->GetPadID());
+      if (iRing == depth)
+        continue;
+      for (auto neighbor : *pad->GetNeighborPadArray())
+      {
+        auto &mark = fPadScanMarks[neighbor->GetPadID()];
+        if (mark == fPadScanGeneration)
+          continue;
+        mark = fPadScanGeneration;
+        fGrabScanPads.push_back(neighbor);
+      }
+    }
+    ringBegin = ringEnd;
+  }
+}
+
+void LHHelixTrackFindingTask::ResetPadPlaneHitMap()
+{
+  if (!fUseSparsePadReset)
+  {
+    fPadPlane->ResetHitMap();
+    return;
+  }
+
+  for (auto padID : fDirtyPadIDs)
+  {
+    auto pad = fPadPlane->GetPad(padID);
+    pad->LetGo();
+    pad->ClearHits();
+    fIsPadDirty[padID] = false;
+  }
+  fDirtyPadIDs.clear();
+  fDirtyPadsSorted = true;
+  fNextFreePadIndex = 0;
+  fFreePadID = 0;
+}
+
+void LHHelixTrackFindingTask::ResetPadPlaneEvent()
+{
+  if (!fUseSparsePadReset)
+  {
     fPadPlane->ResetEvent();
+    return;
+  }
 
-    fTrackHits->Clear();
-    fCandHits->Clear();
-    fGoodHits->Clear();
-    ReturnBadHitsToPadPlane();
+  // grabbed pads without hits are in the dirty pads as well
+  for (auto padID : fDirtyPadIDs)
+    fPadPlane->GetPad(padID)->LetGo();
+  fNextFreePadIndex = 0;
+  fFreePadID = 0;
+}
 
-    // fMinHitsToFitInitTrack = 7;
-    // fCutMinNumHitsInitTrack = 10;
-    fCutMaxNumHitsInitTrack = 25;
-    // fCutMinNumHitsFinalTrack = 15;
-    // fCutMinHelixRadius = 30.;
-    // fTrackLengthCutScale = 2.5;
-    // fCutdkInExpectedTrackPath = 4.;
+KBTpcHit *LHHelixTrackFindingTask::PullOutNextFreeHit()
+{
+  if (!fUseSparsePadReset)
+    return fPadPlane->PullOutNextFreeHit();
 
-    return kStepNewTrack;
+  // same order as the scan of KBPadPlane : pads in ID order from the scan position on,
+  // pads behind the scan position are not visited again until the next reset
+  if (!fDirtyPadsSorted)
+  {
+    sort(fDirtyPadIDs.begin(), fDirtyPadIDs.end());
+    fDirtyPadsSorted = true;
+    fNextFreePadIndex = lower_bound(fDirtyPadIDs.begin(), fDirtyPadIDs.end(), fFreePadID) - fDirtyPadIDs.begin();
+  }
+
+  while (fNextFreePadIndex < fDirtyPadIDs.size())
+  {
+    Int_t padID = fDirtyPadIDs[fNextFreePadIndex];
+    auto hit = fPadPlane->GetPad(padID)->PullOutNextFreeHit();
+    if (hit != nullptr)
+    {
+      fFreePadID = padID;
+      return hit;
+    }
+    fFreePadID = padID + 1;
+    ++fNextFreePadIndex;
+  }
+
+  return nullptr;
+}
+
+void LHHelixTrackFindingTask::ClearRemovedTrackCands(KBTpcHit *hit)
+{
+  // hits of removed tracks carry -1 candidates which would keep them out of new tracks
+  Int_t numCands = hit->GetNumTrackCands();
+  for (Int_t iCand = 0; iCand < numCands; ++iCand)
+    hit->RemoveTrackCand(-1);
+}
+
+void LHHelixTrackFindingTask::RefillPadPlaneWithLeftoverHits()
+{
+  ResetPadPlaneHitMap();
+
+  auto refill = [this](KBTpcHit *hit)
+  {
+    if (CheckParentTrackID(hit) >= 0)
+      return;
+
+    ClearRemovedTrackCands(hit);
+    AddHitToPadPlane(hit);
+  };
+
+  if (fIsSectorWorker)
+  {
+    for (auto hit : fSectorHits)
+      refill(hit);
+  }
+  else
+  {
+    Int_t numHits = fHitArray->GetEntriesFast();
+    for (Int_t iHit = 0; iHit < numHits; ++iHit)
+      refill((KBTpcHit *)fHitArray->At(iHit));
   }
-  else if (fPhaseIndex == 1)
-    return kStepEndEvent;
 }
 
 int LHHelixTrackFindingTask::StepEndEvent()
 {
   fTrackArray->Compress();
 
+  if (fIsSectorWorker)
+    return kStepEndOfEvent;
+
+  if (fUseSplitTrackMerging)
+    MergeSplitTracks();
+
+#ifdef FT
+  if (fFTMatcher != nullptr)
+    MatchFTHits();
+#endif
+
   Int_t numTracks = fTrackArray->GetEntriesFast();
   for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
   {
@@ -507,7 +944,32 @@ int LHHelixTrackFindingTask::StepEndEvent()
     track->FinalizeHits();
   }
 
+  if (fCompactTrackArray != nullptr)
+  {
+    fCompactTrackArray->Clear("C");
+    Int_t numMatches = fFTMatches.size();
+    Int_t iMatch = 0;
+    for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+    {
+      auto compactTrack = (LHCompactTrack *)fCompactTrackArray->ConstructedAt(iTrack, "C");
+      compactTrack->Fill((KBHelixTrack *)fTrackArray->At(iTrack), fHitArray, fReferenceAxis);
+
+      // matches are sorted by track
+      fHitIndices_FT.clear();
+      for (; iMatch < numMatches && fFTMatches[iMatch].fTrackIndex == iTrack; ++iMatch)
+        fHitIndices_FT.push_back(fFTMatches[iMatch].fHitIndex);
+      compactTrack->SetHitIndices_FT(fHitIndices_FT);
+    }
+  }
+
   kb_info << "Number of found tracks: " << fTrackArray->GetEntries() << endl;
+  if (LHAllocationCounter::IsEnabled())
+  {
+    fNumAllocationsInEvent = LHAllocationCounter::GetCount() - fNumAllocationsAtEventStart;
+    kb_info << "Heap allocations in event: " << fNumAllocationsInEvent << endl;
+  }
+  for (UInt_t iPhase = 0; iPhase < fPhaseTimes.size(); ++iPhase)
+    kb_info << "  phase " << iPhase << " : " << fPhaseNumTracks[iPhase] << " tracks, " << 1000 * fPhaseTimes[iPhase] << " ms" << endl;
 
   return kStepEndOfEvent;
 }
@@ -521,11 +983,115 @@ void LHHelixTrackFindingTask::ReturnBadHitsToPadPlane()
   fNumBadHits = fBadHits->GetEntriesFast(); // badhit solved
   for (Int_t iBad = 0; iBad < fNumBadHits; ++iBad)
   {
-    fPadPlane->AddHit((KBTpcHit *)fBadHits->GetHit(iBad));
+    AddHitToPadPlane((KBTpcHit *)fBadHits->GetHit(iBad));
   }
   fBadHits->Clear();
 }
 
+void LHHelixTrackFindingTask::MatchFTHits()
+{
+  fFTMatcher->SetHits(fHitArray_FT);
+  fFTMatcher->MatchTracks(fTrackArray, fFTMatches);
+
+  // FT hits are kept out of the TPC hit arrays of the tracks; the matches are stored by index
+  fFTMatchArray->Clear("C");
+  Int_t numMatches = fFTMatches.size();
+  for (Int_t iMatch = 0; iMatch < numMatches; ++iMatch)
+  {
+    auto &match = fFTMatches[iMatch];
+    auto association = (LHFTAssociation *)fFTMatchArray->ConstructedAt(iMatch, "C");
+    association->SetTrackID(match.fTrackIndex);
+    association->SetHitIndex(match.fHitIndex);
+    association->SetPlane(match.fPlane);
+    association->SetChi2(match.fChi2);
+    association->SetLength(match.fLength);
+  }
+
+  lh_debug << "[FT matches] :: " << numMatches << " in " << fFTMatcher->GetNumPlanes() << " planes" << endl;
+}
+
+void LHHelixTrackFindingTask::FindSeeds()
+{
+  if (fIsSectorWorker)
+    fSeedFinder->FindSeeds(fSectorHits, fSeeds);
+  else
+    fSeedFinder->FindSeeds(fHitArray, fSeeds);
+  fSeedIndex = 0;
+}
+
+void LHHelixTrackFindingTask::FitTrack(KBHelixTrack *track)
+{
+  InvalidateHelixFrame();
+  fFitter->Fit(track);
+}
+
+void LHHelixTrackFindingTask::FitTrackPlane(KBHelixTrack *track)
+{
+  InvalidateHelixFrame();
+  fFitter->FitPlane(track);
+}
+
+const LHHelixFrame &LHHelixTrackFindingTask::GetHelixFrame(KBHelixTrack *track)
+{
+  // every change of the hits or of the fit goes through AddHitToTrack, FitTrack, FitTrackPlane or invalidates explicitly
+  if (fHelixFrame.fTrack == track)
+    return fHelixFrame;
+
+  fHelixFrame.fTrack = track;
+  fHelixFrame.fMappedHead = track->Map(track->PositionAtHead());
+  fHelixFrame.fMappedTail = track->Map(track->PositionAtTail());
+  fHelixFrame.fTrackLength = track->TrackLength();
+  fHelixFrame.fAlphaPerLength = track->AlphaAtTravelLength(1.);
+  return fHelixFrame;
+}
+
+bool LHHelixTrackFindingTask::PullOutNextSeed(KBHitArray *seedHits)
+{
+  Int_t numSeeds = fSeeds.size();
+  while (fSeedIndex < numSeeds)
+  {
+    auto &seed = fSeeds[fSeedIndex++];
+
+    // pull out the pads of the seed hits and keep only the seed hits which are still free
+    for (auto seedHit : seed.fHits)
+    {
+      if (seedHit->GetNumTrackCands() != 0)
+        continue;
+      KBVector3 qos(seedHit->GetPosition(), fReferenceAxis);
+      PullOutNeighborHits(qos.I(), qos.J(), 0, fCandHits);
+    }
+
+    Int_t numPulled = fCandHits->GetEntriesFast();
+    fStepNumPulledHits[fRunningStep] += numPulled;
+    for (Int_t iPulled = 0; iPulled < numPulled; ++iPulled)
+    {
+      auto hit = (KBTpcHit *)fCandHits->GetHit(iPulled);
+      if (hit->GetNumTrackCands() == 0 && find(seed.fHits.begin(), seed.fHits.end(), hit) != seed.fHits.end())
+        seedHits->AddHit(hit);
+      else
+        AddHitToPadPlane(hit);
+    }
+    fCandHits->Clear();
+
+    if (seedHits->GetEntriesFast() >= fSeedFinder->GetMinSeedHits())
+      return true;
+
+    Int_t numSeedHits = seedHits->GetEntriesFast();
+    for (Int_t iSeedHit = 0; iSeedHit < numSeedHits; ++iSeedHit)
+      AddHitToPadPlane((KBTpcHit *)seedHits->GetHit(iSeedHit));
+    seedHits->Clear();
+  }
+
+  return false;
+}
+
+bool LHHelixTrackFindingTask::CheckInitTrackIsHelix(KBHelixTrack *track)
+{
+  return (track->GetNumHits() > fCutMinNumHitsInitTrack &&
+          track->GetHelixRadius() > fCutMinHelixRadius &&
+          track->TrackLength() > fTrackLengthCutScale * track->GetRMST());
+}
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -652,8 +1218,9 @@ double LHHelixTrackFindingTask::CorrelateHitWithTrack(KBHelixTrack *track, KBTpc
     rmsHCut = trackHCutHL;
   rmsHCut = scale * rmsHCut;
 
-  TVector3 qHead = track->Map(track->PositionAtHead());
-  TVector3 qTail = track->Map(track->PositionAtTail());
+  auto &frame = GetHelixFrame(track);
+  const TVector3 &qHead = frame.fMappedHead;
+  const TVector3 &qTail = frame.fMappedTail;
   TVector3 q = track->Map(hit->GetPosition());
 
   if (qHead.Z() > qTail.Z())
@@ -687,6 +1254,7 @@ double LHHelixTrackFindingTask::CorrelateHitWithTrack(KBHelixTrack *track, KBTpc
 bool LHHelixTrackFindingTask::BuildAndConfirmTrack(KBHelixTrack *track, bool &tailToHead)
 {
   track->SortHits(!tailToHead);
+  InvalidateHelixFrame();
   auto trackHits = track->GetHitArray();
   Int_t numHits = trackHits->GetNumHits();
 
@@ -702,9 +1270,12 @@ bool LHHelixTrackFindingTask::BuildAndConfirmTrack(KBHelixTrack *track, bool &ta
     if (quality <= 0)
     {
       track->RemoveHit(trackHit);
+      InvalidateHelixFrame();
+      if (fStepTrace != nullptr)
+        Trace(LHStepTraceRecord::kTraceHitRemoved, fRunningStep, fRunningStep, trackHit->GetHitID());
       trackHit->RemoveTrackCand(trackHit->GetTrackID());
       Int_t helicity = track->Helicity();
-      track->Fit();
+      FitTrack(track);
       if (helicity != track->Helicity())
         tailToHead = !tailToHead;
 
@@ -750,18 +1321,19 @@ bool LHHelixTrackFindingTask::AutoBuildAtPosition(KBHelixTrack *track, TVector3
     rms = 25;
 
   Int_t range = Int_t(rms / 8);
-  fPadPlane->PullOutNeighborHits(p2.I(), p2.J(), range, fCandHits);
+  PullOutNeighborHits(p2.I(), p2.J(), range, fCandHits);
   fNumCandHits = fCandHits->GetEntriesFast();
+  fStepNumPulledHits[fRunningStep] += fNumCandHits;
   Bool_t foundHit = false;
 
   if (fNumCandHits != 0)
   {
-    fCandHits->SortByCharge(false);
+    fCandHeap.OrderByCharge(false);
+    fCandHeap.Build(fCandHits);
 
     for (Int_t iHit = 0; iHit < fNumCandHits; iHit++)
     {
-      KBTpcHit *candHit = (KBTpcHit *)fCandHits->GetLastHit();
-      fCandHits->RemoveLastHit();
+      KBTpcHit *candHit = fCandHeap.PopHit(fCandHits);
 
       Double_t quality = 0;
       if (CheckParentTrackID(candHit) < 0)
@@ -769,8 +1341,8 @@ bool LHHelixTrackFindingTask::AutoBuildAtPosition(KBHelixTrack *track, TVector3
 
       if (quality > 0)
       {
-        track->AddHit(candHit);
-        track->Fit();
+        AddHitToTrack(track, candHit);
+        FitTrack(track);
         foundHit = true;
       }
       else
@@ -786,8 +1358,11 @@ bool LHHelixTrackFindingTask::AutoBuildAtPosition(KBHelixTrack *track, TVector3
   }
   else
   {
-    extrapolationLength += 10;
-    if (extrapolationLength > 3 * track->TrackLength())
+    if (fUseAnalyticStepping)
+      extrapolationLength = NextPadRowCrossing(track, tailToHead, extrapolationLength);
+    else
+      extrapolationLength += 10;
+    if (extrapolationLength < 0 || extrapolationLength > 3 * track->TrackLength())
     {
       return false;
     }
@@ -796,6 +1371,89 @@ bool LHHelixTrackFindingTask::AutoBuildAtPosition(KBHelixTrack *track, TVector3
   return true;
 }
 
+void LHHelixTrackFindingTask::BuildPopulatedRowRadii()
+{
+  fRowRadiusSum.assign(fRowRadiusSum.size(), 0.);
+  fRowNumHits.assign(fRowNumHits.size(), 0);
+  auto addHit = [&](KBTpcHit *hit)
+  {
+    Int_t layer = hit->GetLayer();
+    if (layer < 0)
+      return;
+    if (layer >= Int_t(fRowNumHits.size()))
+    {
+      fRowRadiusSum.resize(layer + 1, 0.);
+      fRowNumHits.resize(layer + 1, 0);
+    }
+    KBVector3 qos(hit->GetPosition(), fReferenceAxis);
+    fRowRadiusSum[layer] += sqrt(qos.I() * qos.I() + qos.J() * qos.J());
+    fRowNumHits[layer]++;
+  };
+
+  if (fIsSectorWorker)
+  {
+    for (auto hit : fSectorHits)
+      addHit(hit);
+  }
+  else
+  {
+    Int_t numHits = fHitArray->GetEntriesFast();
+    for (Int_t iHit = 0; iHit < numHits; ++iHit)
+      addHit((KBTpcHit *)fHitArray->At(iHit));
+  }
+
+  fPopulatedRowRadii.clear();
+  for (UInt_t layer = 0; layer < fRowNumHits.size(); ++layer)
+    if (fRowNumHits[layer] > 0)
+      fPopulatedRowRadii.push_back(fRowRadiusSum[layer] / fRowNumHits[layer]);
+}
+
+Double_t LHHelixTrackFindingTask::NextPadRowCrossing(KBHelixTrack *track, bool buildHead, Double_t extrapolationLength)
+{
+  // Returns the extrapolation length of the closest crossing, beyond extrapolationLength,
+  // between the helix and a populated pad row (circle around the beam axis), or -1 if there is none.
+  Double_t alphaPerLength = abs(track->AlphaAtTravelLength(1.));
+  if (alphaPerLength <= 0 || fPopulatedRowRadii.empty())
+    return extrapolationLength + 10;
+
+  Double_t ci = track->GetHelixCenterI();
+  Double_t cj = track->GetHelixCenterJ();
+  Double_t radius = track->GetHelixRadius();
+  Double_t distCenter = sqrt(ci * ci + cj * cj);
+  if (distCenter <= 0 || radius <= 0)
+    return extrapolationLength + 10;
+
+  KBVector3 pEnd(buildHead ? track->PositionAtHead() : track->PositionAtTail(), fReferenceAxis);
+  KBVector3 pStep(buildHead ? track->ExtrapolateHead(1.) : track->ExtrapolateTail(1.), fReferenceAxis);
+  Double_t alphaEnd = TMath::ATan2(pEnd.J() - cj, pEnd.I() - ci);
+  Double_t alphaStep = TMath::ATan2(pStep.J() - cj, pStep.I() - ci);
+  Double_t direction = (sin(alphaStep - alphaEnd) > 0 ? 1 : -1);
+
+  Double_t phiCenter = TMath::ATan2(cj, ci);
+  Double_t nextLength = -1;
+  for (auto rowRadius : fPopulatedRowRadii)
+  {
+    // |c + R(cos a, sin a)| = r  ->  cos(a - phiCenter) = (r^2 - |c|^2 - R^2) / (2 R |c|)
+    Double_t cosAlpha = (rowRadius * rowRadius - distCenter * distCenter - radius * radius) / (2 * radius * distCenter);
+    if (abs(cosAlpha) > 1)
+      continue;
+
+    Double_t dAlphaRow = acos(cosAlpha);
+    for (auto alphaRow : {phiCenter + dAlphaRow, phiCenter - dAlphaRow})
+    {
+      Double_t dAlpha = fmod(direction * (alphaRow - alphaEnd), TMath::TwoPi());
+      if (dAlpha < 0)
+        dAlpha += TMath::TwoPi();
+
+      Double_t length = dAlpha / alphaPerLength;
+      if (length > extrapolationLength + fMinPadRowStep && (nextLength < 0 || length < nextLength))
+        nextLength = length;
+    }
+  }
+
+  return nextLength;
+}
+
 int LHHelixTrackFindingTask::CheckParentTrackID(KBTpcHit *hit)
 {
   vector<Int_t> *candTracks = hit->GetTrackCandArray();
@@ -831,6 +1489,7 @@ double LHHelixTrackFindingTask::CheckTrackContinuity(KBHelixTrack *track)
     return -1;
 
   track->SortHits();
+  InvalidateHelixFrame();
 
   Double_t total = 0;
   Double_t continuous = 0;
@@ -874,9 +1533,11 @@ bool LHHelixTrackFindingTask::CheckHitDistInAlphaIsLargerThanQuarterPi(KBHelixTr
 {
   if (dLength > 0)
   {
-    if (dLength > .5 * track->TrackLength())
+    // AlphaAtTravelLength is linear in the length
+    auto &frame = GetHelixFrame(track);
+    if (dLength > .5 * frame.fTrackLength)
     {
-      if (abs(track->AlphaAtTravelLength(dLength)) > .5 * TMath::Pi())
+      if (abs(frame.fAlphaPerLength * dLength) > .5 * TMath::Pi())
       {
         return true;
       }
@@ -884,3 +1545,277 @@ bool LHHelixTrackFindingTask::CheckHitDistInAlphaIsLargerThanQuarterPi(KBHelixTr
   }
   return false;
 }
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void LHHelixTrackFindingTask::CopyConfigurationTo(LHHelixTrackFindingTask *worker) const
+{
+  // everything set through the setters or read in Init which changes how a sector is tracked
+  worker->fDefaultScale = fDefaultScale;
+  worker->fTrackWCutLL = fTrackWCutLL;
+  worker->fTrackWCutHL = fTrackWCutHL;
+  worker->fTrackHCutLL = fTrackHCutLL;
+  worker->fTrackHCutHL = fTrackHCutHL;
+  worker->fReferenceAxis = fReferenceAxis;
+
+  worker->fPhases = fPhases;
+  worker->fMinHitsToFitInitTrack = fMinHitsToFitInitTrack;
+  worker->fCutMinNumHitsInitTrack = fCutMinNumHitsInitTrack;
+  worker->fCutMaxNumHitsInitTrack = fCutMaxNumHitsInitTrack;
+  worker->fCutMinNumHitsFinalTrack = fCutMinNumHitsFinalTrack;
+  worker->fCutMinHelixRadius = fCutMinHelixRadius;
+  worker->fTrackLengthCutScale = fTrackLengthCutScale;
+  worker->fCutdkInExpectedTrackPath = fCutdkInExpectedTrackPath;
+
+  worker->fUseSeeding = fUseSeeding;
+  worker->fUseAnalyticStepping = fUseAnalyticStepping;
+  worker->fMinPadRowStep = fMinPadRowStep;
+  worker->fUseSparsePadReset = fUseSparsePadReset;
+  worker->fHitArrayCapacity = fHitArrayCapacity;
+  worker->fUseStepTiming = fUseStepTiming;
+}
+
+void LHHelixTrackFindingTask::InitSectorWorkers()
+{
+  ROOT::EnableThreadSafety();
+
+  Double_t sectorWidth = TMath::TwoPi() / fNumSectors;
+  if (fSectorOverlap > .5 * sectorWidth)
+  {
+    kb_warning << "Sector overlap " << fSectorOverlap << " is larger than half of the sector width. Using " << .5 * sectorWidth << endl;
+    fSectorOverlap = .5 * sectorWidth;
+  }
+
+  for (Int_t iSector = 0; iSector < fNumSectors; ++iSector)
+  {
+    auto worker = new LHHelixTrackFindingTask();
+    worker->fIsSectorWorker = true;
+    worker->fTrackIDOffset = (iSector + 1) * 100000;
+    worker->fPar = fPar;
+
+    worker->fTpc = new LHTpc();
+    worker->fTpc->SetParameterContainer(fPar);
+    worker->fTpc->Init();
+    worker->fPadPlane = (KBPadPlane *)worker->fTpc->GetPadPlane();
+
+    CopyConfigurationTo(worker);
+
+    worker->fFitter = new KBHelixTrackFitter();
+    worker->fTrackArray = new TClonesArray("KBHelixTrack");
+    worker->CreateHitArrays();
+
+    if (fUseSeeding)
+    {
+      worker->fSeedFinder = new LHHelixSeedFinder();
+      worker->fSeedFinder->SetReferenceAxis(fReferenceAxis);
+      worker->fSeedFinder->SetNumThreads(1);
+      worker->fSeedFinder->SetCutMinHelixRadius(fCutMinHelixRadius);
+    }
+
+    fSectorTasks.push_back(worker);
+  }
+}
+
+void LHHelixTrackFindingTask::FindSectors(TVector3 position, vector<Int_t> &sectors)
+{
+  sectors.clear();
+
+  KBVector3 qos(position, fReferenceAxis);
+  Double_t sectorWidth = TMath::TwoPi() / fNumSectors;
+  Double_t phi = TMath::ATan2(qos.J(), qos.I()) + TMath::Pi();
+
+  Int_t sector = Int_t(phi / sectorWidth);
+  if (sector >= fNumSectors)
+    sector = fNumSectors - 1;
+  sectors.push_back(sector);
+
+  Double_t phiInSector = phi - sector * sectorWidth;
+  if (phiInSector < fSectorOverlap)
+    sectors.push_back((sector - 1 + fNumSectors) % fNumSectors);
+  if (sectorWidth - phiInSector < fSectorOverlap)
+    sectors.push_back((sector + 1) % fNumSectors);
+}
+
+void LHHelixTrackFindingTask::ExecSectors()
+{
+  fNumAllocationsAtEventStart = LHAllocationCounter::GetCount();
+  fCurrentTrack = nullptr;
+  fTrackArray->Clear("C");
+
+  for (auto worker : fSectorTasks)
+    worker->fSectorHits.clear();
+
+  vector<Int_t> sectors;
+  Int_t numHits = fHitArray->GetEntriesFast();
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+  {
+    auto hit = (KBTpcHit *)fHitArray->At(iHit);
+    FindSectors(hit->GetPosition(), sectors);
+    for (auto sector : sectors)
+      fSectorTasks[sector]->fSectorHits.push_back(hit);
+  }
+
+  // even sectors, odd sectors, and the last sector if it would touch sector 0 in the same pass
+  vector<vector<Int_t>> passes(3);
+  for (Int_t iSector = 0; iSector < fNumSectors; ++iSector)
+  {
+    if (fNumSectors % 2 == 1 && iSector == fNumSectors - 1)
+      passes[2].push_back(iSector);
+    else
+      passes[iSector % 2].push_back(iSector);
+  }
+
+  for (auto &pass : passes)
+  {
+    LHParallelFor(pass.size(), fNumSectorThreads, [&](int i)
+                  { fSectorTasks[pass[i]]->Exec(""); });
+  }
+
+  // phase summary of the event: real time summed over sectors
+  fPhaseTimes.assign(fPhases.size(), 0.);
+  fPhaseNumTracks.assign(fPhases.size(), 0);
+  for (auto worker : fSectorTasks)
+  {
+    for (UInt_t iPhase = 0; iPhase < fPhases.size(); ++iPhase)
+    {
+      fPhaseTimes[iPhase] += worker->fPhaseTimes[iPhase];
+      fPhaseNumTracks[iPhase] += worker->fPhaseNumTracks[iPhase];
+    }
+  }
+
+  MergeSectorTracks();
+
+  fNextStep = StepEndEvent();
+}
+
+void LHHelixTrackFindingTask::MergeSectorTracks()
+{
+  vector<KBHelixTrack *> tracks;
+  vector<Int_t> trackSectors;
+  for (Int_t iSector = 0; iSector < fNumSectors; ++iSector)
+  {
+    auto sectorTrackArray = fSectorTasks[iSector]->fTrackArray;
+    Int_t numSectorTracks = sectorTrackArray->GetEntriesFast();
+    for (Int_t iTrack = 0; iTrack < numSectorTracks; ++iTrack)
+    {
+      auto track = (KBHelixTrack *)sectorTrackArray->At(iTrack);
+      if (track == nullptr)
+        continue;
+      tracks.push_back(track);
+      trackSectors.push_back(iSector);
+    }
+  }
+
+  Int_t numTracks = tracks.size();
+  vector<Int_t> group(numTracks);
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+    group[iTrack] = iTrack;
+
+  auto findGroup = [&group](Int_t i)
+  {
+    while (group[i] != i)
+      i = group[i] = group[group[i]];
+    return i;
+  };
+
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    for (Int_t jTrack = iTrack + 1; jTrack < numTracks; ++jTrack)
+    {
+      auto dSector = (trackSectors[jTrack] - trackSectors[iTrack] + fNumSectors) % fNumSectors;
+      if (dSector != 1 && dSector != fNumSectors - 1)
+        continue;
+      if (!CheckSectorTracksMatch(tracks[iTrack], tracks[jTrack]))
+        continue;
+      auto iGroup = findGroup(iTrack);
+      auto jGroup = findGroup(jTrack);
+      if (iGroup < jGroup)
+        group[jGroup] = iGroup;
+      else
+        group[iGroup] = jGroup;
+    }
+  }
+
+  vector<Int_t> groupTrackIndex(numTracks, -1);
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    auto iGroup = findGroup(iTrack);
+    if (groupTrackIndex[iGroup] < 0)
+    {
+      Int_t idx = fTrackArray->GetEntriesFast();
+      auto track = (KBHelixTrack *)fTrackArray->ConstructedAt(idx, "C");
+      track->SetTrackID(idx);
+      track->SetReferenceAxis(fReferenceAxis);
+      groupTrackIndex[iGroup] = idx;
+    }
+
+    auto track = (KBHelixTrack *)fTrackArray->At(groupTrackIndex[iGroup]);
+    auto sectorTrackHits = tracks[iTrack]->GetHitArray();
+    Int_t numHits = sectorTrackHits->GetNumHits();
+    for (Int_t iHit = 0; iHit < numHits; ++iHit)
+      track->AddHit(sectorTrackHits->GetHit(iHit));
+  }
+
+  Int_t numMergedTracks = fTrackArray->GetEntriesFast();
+  for (Int_t iTrack = 0; iTrack < numMergedTracks; ++iTrack)
+    FitTrack((KBHelixTrack *)fTrackArray->At(iTrack));
+
+  lh_debug << "[sector tracks] :: " << numTracks << " -> " << numMergedTracks << endl;
+}
+
+void LHHelixTrackFindingTask::MergeSplitTracks()
+{
+  fSplitTrackMerger.FindGroups(fTrackArray, fSplitTrackGroups);
+  if (fSplitTrackGroups.empty())
+    return;
+
+  Int_t numTracks = fTrackArray->GetEntriesFast();
+  for (auto &group : fSplitTrackGroups)
+  {
+    auto track = (KBHelixTrack *)fTrackArray->At(group[0]);
+    for (UInt_t iMember = 1; iMember < group.size(); ++iMember)
+    {
+      auto member = (KBHelixTrack *)fTrackArray->At(group[iMember]);
+      auto memberHits = member->GetHitArray();
+      Int_t numHits = memberHits->GetNumHits();
+      for (Int_t iHit = 0; iHit < numHits; ++iHit)
+        track->AddHit(memberHits->GetHit(iHit));
+      fTrackArray->RemoveAt(group[iMember]);
+    }
+    FitTrack(track);
+  }
+  fTrackArray->Compress();
+
+  lh_debug << "[split tracks] :: " << numTracks << " -> " << fTrackArray->GetEntriesFast() << endl;
+}
+
+bool LHHelixTrackFindingTask::CheckSectorTracksMatch(KBHelixTrack *track1, KBHelixTrack *track2)
+{
+  Double_t r1 = track1->GetHelixRadius();
+  Double_t r2 = track2->GetHelixRadius();
+  Double_t rMax = (r1 > r2 ? r1 : r2);
+  if (abs(r1 - r2) > fCutMergeRadius * rMax)
+    return false;
+
+  Double_t di = track1->GetHelixCenterI() - track2->GetHelixCenterI();
+  Double_t dj = track1->GetHelixCenterJ() - track2->GetHelixCenterJ();
+  Double_t centerCut = fCutMergeCenter;
+  if (centerCut < fCutMergeRadius * rMax)
+    centerCut = fCutMergeRadius * rMax;
+  if (sqrt(di * di + dj * dj) > centerCut)
+    return false;
+
+  if (abs(track1->DipAngle() - track2->DipAngle()) > fCutMergeDip)
+    return false;
+
+  TVector3 ends1[2] = {track1->PositionAtHead(), track1->PositionAtTail()};
+  TVector3 ends2[2] = {track2->PositionAtHead(), track2->PositionAtTail()};
+  for (auto &end1 : ends1)
+    for (auto &end2 : ends2)
+      if ((end1 - end2).Mag() < fCutMergeGap)
+        return true;
+
+  return false;
+}
@@ -3,29 +3,145 @@
 
 #include "TClonesArray.h"
 #include "TGraphErrors.h"
+#include "TStopwatch.h"
+#include "TDirectory.h"
 
 #include "KBTask.hh"
 #include "KBHelixTrack.hh"
+#include "KBHelixTrackFitter.hh"
 #include "KBTpcHit.hh"
 #include "KBHitArray.hh"
 
 #include "LHTpc.hh"
 #include "KBPadPlane.hh"
 
+#include "LHHelixSeedFinder.hh"
+#include "LHFTTrackMatcher.hh"
+#include "LHFTAssociation.hh"
+#include "LHSplitTrackMerger.hh"
+#include "LHCandidateHeap.hh"
+#include "LHStepTrace.hh"
+#include "LHCompactTrack.hh"
+
 #include <vector>
 using namespace std;
 
+/// Helix quantities used for every candidate hit, valid until the track is changed or refitted
+struct LHHelixFrame
+{
+  KBHelixTrack *fTrack = nullptr; ///< nullptr : invalid
+  TVector3 fMappedHead;           ///< Map(PositionAtHead())
+  TVector3 fMappedTail;           ///< Map(PositionAtTail())
+  Double_t fTrackLength = 0;
+  Double_t fAlphaPerLength = 0;   ///< AlphaAtTravelLength(1)
+};
+
+/// Cuts of one tracking phase. Phases run in the order they are added to LHHelixTrackFindingTask.
+struct LHHelixTrackFindingPhase
+{
+  Int_t fMinHitsToFitInitTrack = 7;
+  Int_t fCutMinNumHitsInitTrack = 10;
+  Int_t fCutMaxNumHitsInitTrack = 15;
+  Int_t fCutMinNumHitsFinalTrack = 15;
+  Double_t fCutMinHelixRadius = 30.;
+  Double_t fTrackLengthCutScale = 2.5;
+  Double_t fCutdkInExpectedTrackPath = 4.;
+  bool fLeftoverHitsOnly = false; ///< refill the pad plane only with hits not used by tracks of earlier phases, instead of KBPadPlane::ResetEvent
+};
+
 class LHHelixTrackFindingTask : public KBTask
 {
 public:
   LHHelixTrackFindingTask() : KBTask("LHHelixTrackFindingTask", "LHHelixTrackFindingTask") {}
-  virtual ~LHHelixTrackFindingTask() {}
+  virtual ~LHHelixTrackFindingTask();
 
   virtual bool Init();
   virtual void Exec(Option_t *);
+  /// Writes the step histograms to the KBRun output file, before KBRun closes it
+  virtual bool EndOfRun();
 
   void SetTrackPersistency(bool val) { fPersistency = val; }
 
+  /**
+   * Compact persistency : the Tracklet branch is kept in memory only and
+   * fBranchNameCompactTracklet ("TrackletCompact") is written instead, one
+   * LHCompactTrack (helix, covariance, fit quality, hit indices) per track.
+   * LHCompactTrack::Rebuild recreates the full KBHelixTrack from the hit branches.
+   */
+  void SetCompactTrackletPersistency(bool val) { fUseCompactPersistency = val; }
+  void SetCompactTrackletBranchName(TString name) { fBranchNameCompactTracklet = name; }
+
+  /// Take initial hits from the seeding stage (LHHelixSeedFinder) before falling back to PullOutNextFreeHit
+  void SetSeedingMode(bool val) { fUseSeeding = val; }
+  void SetNumSeedingThreads(Int_t val) { fNumSeedingThreads = val; }
+  LHHelixSeedFinder *GetSeedFinder() const { return fSeedFinder; }
+
+  /**
+   * Phi-sector mode (numSectors > 1)
+   *
+   * The pad plane is split into numSectors azimuthal sectors, each widened by
+   * fSectorOverlap [rad] on both sides, and the step state machine runs on a
+   * private pad plane per sector. Even sectors run concurrently first and odd
+   * sectors after them, so two concurrent workers never share a hit. Hits
+   * used by tracks of a neighbouring sector are not offered again, hits of
+   * tracks it removed are. Tracks of
+   * adjacent sectors with compatible helices are merged at the end of the event.
+   * Every sector worker has its own pad plane and helix fitter, so the workers
+   * share no state and take no lock. Use about twice as many sectors as threads
+   * so both passes keep all cores busy; bench_sectors (bench_tracking.C) prints
+   * the speed-up and the agreement with the sequential mode per thread count.
+   *
+   * Tolerance with respect to the sequential mode: the same tracks are found up
+   * to the seed order, except that a track crossing a sector boundary stays split
+   * if its two pieces differ by more than the merge cuts (helix center
+   * fCutMergeCenter or fCutMergeRadius * R, radius fCutMergeRadius * R, dip angle
+   * fCutMergeDip, end-point gap fCutMergeGap).
+   */
+  void SetNumSectors(Int_t val) { fNumSectors = val; }
+  void SetSectorOverlap(Double_t val) { fSectorOverlap = val; }
+  void SetNumSectorThreads(Int_t val) { fNumSectorThreads = val; }
+
+  /**
+   * Tracking phases. Each phase restarts track seeding with its own cuts, and
+   * the tracks of earlier phases are frozen. By default a later phase starts
+   * from KBPadPlane::ResetEvent like the original second pass; with
+   * fLeftoverHitsOnly it only sees the hits which earlier phases left unused
+   * or returned. Without AddPhase the task runs two default phases, the second
+   * one with fCutMaxNumHitsInitTrack = 25, which reproduces the original task.
+   */
+  void AddPhase(LHHelixTrackFindingPhase phase) { fPhases.push_back(phase); }
+  void ClearPhases() { fPhases.clear(); }
+
+  /// Heap allocations during the last event, -1 without an allocation count hook (see LHAllocationCounter)
+  Long64_t GetNumAllocationsInEvent() const { return fNumAllocationsInEvent; }
+
+  /**
+   * FT hits take no part in track finding. After the last phase every track is
+   * extrapolated to the FT planes and the best FT hits are matched to it by
+   * LHFTTrackMatcher. The matches go to the FT match branch (LHFTAssociation);
+   * the hits and helix of the track are left as found in the TPC. Cuts are set
+   * through GetFTMatcher after Init.
+   */
+  void SetFTMatching(bool val) { fUseFTMatching = val; }
+  void SetFTMatchBranchName(TString name) { fBranchNameFTMatch = name; }
+  LHFTTrackMatcher *GetFTMatcher() const { return fFTMatcher; }
+
+  /// Jump the extrapolation to the next populated pad-row crossing of the helix instead of 10 mm steps (default off until validated against the stepping)
+  void SetAnalyticStepping(bool val) { fUseAnalyticStepping = val; }
+
+  /// Merge tracks with compatible helix parameters at the end of the event (LHSplitTrackMerger), before FT matching. Cuts are set through GetSplitTrackMerger.
+  void SetSplitTrackMerging(bool val) { fUseSplitTrackMerging = val; }
+  LHSplitTrackMerger *GetSplitTrackMerger() { return &fSplitTrackMerger; }
+
+  /**
+   * Keep a list of the pads which received hits or were grabbed, so that
+   * resetting the pad plane between events and phases and pulling the next
+   * free hit only visit those pads instead of every pad (KBPadPlane::ResetHitMap,
+   * ResetEvent and PullOutNextFreeHit scan the full pad array). Off by default
+   * until replay_steptrace shows identical traces with the full reset.
+   */
+  void SetSparsePadReset(bool val) { fUseSparsePadReset = val; }
+
   enum StepNo : int
   {
     kStepInitArray,
@@ -44,8 +160,38 @@ public:
     kStepEndOfEvent,
   };
 
+  enum RemoveReason : int
+  {
+    kRemoveNoCandHit,
+    kRemoveCutMaxNumHits,
+    kRemoveExtrapolation,
+    kRemoveConfirmation1,
+    kRemoveConfirmation2,
+    kNumRemoveReasons,
+  };
+
   bool ExecStep();
 
+  /**
+   * Step instrumentation. ExecStep counts the executions and transitions of
+   * every step and, with step timing (default off), the time spent in it;
+   * the steps count the hits they pull out of the pad plane and the tracks
+   * they remove per RemoveReason. The counters add up over the run (and over
+   * the sector workers) until ResetStepCounters. WriteStepHistograms writes
+   * them as HTFStepCount, HTFStepTime, HTFStepPulledHits, HTFStepTransition
+   * and HTFRemovedTracks to directory. EndOfRun does so for the KBRun output
+   * file; without one (LHAsyncEventLoop) use SetEndOfRunAction of the loop.
+   */
+  void SetStepTiming(bool val) { fUseStepTiming = val; }
+  void ResetStepCounters();
+  void WriteStepHistograms(TDirectory *directory);
+  Long64_t GetStepCount(Int_t step) const { return fStepCounts[step]; }
+  Double_t GetStepTime(Int_t step) const { return fStepTimes[step]; } ///< [s]
+  Long64_t GetNumRemovedTracks(Int_t reason) const { return fNumRemovedTracks[reason]; }
+
+  /// Record step transitions, hits added to or removed from tracks and track outcomes to a binary side file (see LHStepTrace)
+  void SetStepTraceFile(TString fileName) { fStepTraceFileName = fileName; }
+
   bool ExecStepUptoTrackNum(Int_t numTracks);
 
   KBHelixTrack *GetCurrentTrack() const { return fCurrentTrack; }
@@ -68,8 +214,42 @@ private:
   int StepFinalizeTrack();
   int StepNextPhase();
   int StepEndEvent();
-
+  int DispatchStep(Int_t step);
+  int RemoveTrack(RemoveReason reason);
+  void Trace(UChar_t type, Int_t step, Int_t nextStep, Int_t value);
+  void AddHitToTrack(KBHelixTrack *track, KBHit *hit);
+
+  void CreateHitArrays();
+  void ApplyPhase(Int_t phaseIndex);
+  void EndPhase();
+  void ClearRemovedTrackCands(KBTpcHit *hit);
+  void RefillPadPlaneWithLeftoverHits();
+  void AddHitToPadPlane(KBTpcHit *hit);
+  void MarkPadDirty(Int_t padID);
+  /// KBPadPlane::PullOutNeighborHits, recording the grabbed pads for the sparse reset
+  void PullOutNeighborHits(KBHitArray *hits, KBHitArray *neighborHits);
+  void PullOutNeighborHits(Double_t i, Double_t j, Int_t range, KBHitArray *neighborHits);
+  void MarkGrabbedPadsDirty(Int_t padID, Int_t depth);
+  void ResetPadPlaneHitMap();
+  void ResetPadPlaneEvent();
+  KBTpcHit *PullOutNextFreeHit();
   void ReturnBadHitsToPadPlane();
+  void FindSeeds();
+  void MatchFTHits();
+  void FitTrack(KBHelixTrack *track);
+  void FitTrackPlane(KBHelixTrack *track);
+  const LHHelixFrame &GetHelixFrame(KBHelixTrack *track);
+  void InvalidateHelixFrame() { fHelixFrame.fTrack = nullptr; }
+
+  void CopyConfigurationTo(LHHelixTrackFindingTask *worker) const;
+  void InitSectorWorkers();
+  void ExecSectors();
+  void FindSectors(TVector3 position, vector<Int_t> &sectors);
+  void MergeSectorTracks();
+  void MergeSplitTracks();
+  bool CheckSectorTracksMatch(KBHelixTrack *track1, KBHelixTrack *track2);
+  bool PullOutNextSeed(KBHitArray *seedHits);
+  bool CheckInitTrackIsHelix(KBHelixTrack *track);
 
   double CorrelateHitWithTrackCandidate(KBHelixTrack *track, KBTpcHit *hit);
   double CorrelateHitWithTrack(KBHelixTrack *track, KBTpcHit *hit, Double_t scale = 1);
@@ -83,6 +263,9 @@ private:
   bool AutoBuildByExtrapolation(KBHelixTrack *track, bool &buildHead, Double_t &extrapolationLength);
   bool AutoBuildAtPosition(KBHelixTrack *track, TVector3 p, bool &tailToHead, Double_t &extrapolationLength, Double_t scale = 1);
 
+  void BuildPopulatedRowRadii();
+  Double_t NextPadRowCrossing(KBHelixTrack *track, bool buildHead, Double_t extrapolationLength);
+
 private:
   LHTpc *fTpc = nullptr;
   KBPadPlane *fPadPlane = nullptr;
@@ -90,24 +273,73 @@ private:
   TClonesArray *fHitArray_FT = nullptr; //
 
   TClonesArray *fTrackArray = nullptr;
+  KBHelixTrackFitter *fFitter = nullptr; //! own instance, KBHelixTrack::Fit shares one fitter between all threads
 
   TString fBranchNameHit = "Hit";
-  TString fBranchNameHit_FT = "Hit"; //
+  TString fBranchNameHit_FT = "FTHit";
   TString fBranchNameTracklet = "Tracklet";
+  TString fBranchNameCompactTracklet = "TrackletCompact";
+  TString fBranchNameFTMatch = "FTMatch";
 
   bool fPersistency = true;
-  int cnt = 0;
-  bool firstinit = true;
+  bool fUseCompactPersistency = false;
+  TClonesArray *fCompactTrackArray = nullptr;
 
   KBHitArray *fTrackHits = nullptr;
   KBHitArray *fCandHits = nullptr;
+  LHCandidateHeap fCandHeap; //! pop order of fCandHits
+  LHHelixFrame fHelixFrame;  //! of the last track given to CorrelateHitWithTrack
   KBHitArray *fGoodHits = nullptr;
   KBHitArray *fBadHits = nullptr;
 
-  KBHitArray *fTrackHits_FT = nullptr;
-  KBHitArray *fCandHits_FT = nullptr;
-  KBHitArray *fGoodHits_FT = nullptr;
-  KBHitArray *fBadHits_FT = nullptr;
+  bool fUseSplitTrackMerging = false;
+  LHSplitTrackMerger fSplitTrackMerger; //!
+  vector<vector<Int_t>> fSplitTrackGroups; //!
+
+  bool fUseFTMatching = true;
+  LHFTTrackMatcher *fFTMatcher = nullptr; //!
+  vector<LHFTMatch> fFTMatches;           //!
+  TClonesArray *fFTMatchArray = nullptr;
+  vector<Int_t> fHitIndices_FT; //! of one track, for the compact tracks
+
+  bool fUseSeeding = false;
+  Int_t fNumSeedingThreads = 0;
+  LHHelixSeedFinder *fSeedFinder = nullptr; //!
+  vector<LHHelixSeed> fSeeds;               //!
+  Int_t fSeedIndex = 0;
+  KBHitArray *fSeedHits = nullptr;
+
+  Int_t fNumSectors = 1;
+  Double_t fSectorOverlap = 0.05; ///< [rad]
+  Int_t fNumSectorThreads = 0;    ///< 0 : use all hardware threads
+  Double_t fCutMergeCenter = 30.; ///< helix center distance cut for merging sector tracks
+  Double_t fCutMergeRadius = 0.1; ///< relative helix radius cut for merging sector tracks
+  Double_t fCutMergeDip = 0.05;   ///< dip angle cut for merging sector tracks
+  Double_t fCutMergeGap = 50.;    ///< end-point distance cut for merging sector tracks
+  vector<LHHelixTrackFindingTask *> fSectorTasks; //!
+  bool fIsSectorWorker = false;
+  Int_t fTrackIDOffset = 0;
+  vector<KBTpcHit *> fSectorHits; //!
+
+  bool fUseAnalyticStepping = false;
+
+  bool fUseSparsePadReset = false;
+  vector<Int_t> fDirtyPadIDs;    //! pads holding, having held hits or grabbed since the last reset
+  vector<bool> fIsPadDirty;      //!
+  bool fDirtyPadsSorted = true;  //!
+  UInt_t fNextFreePadIndex = 0;  //! position of the free-hit scan in fDirtyPadIDs
+  Int_t fFreePadID = 0;          //! pad ID of the free-hit scan position
+  vector<KBPad *> fGrabScanPads; //!
+  vector<UInt_t> fPadScanMarks;  //! generation of the last MarkGrabbedPadsDirty call visiting each pad
+  UInt_t fPadScanGeneration = 0; //!
+  Double_t fMinPadRowStep = 1.;      ///< minimum extrapolation step between two pad-row crossings
+  vector<Double_t> fPopulatedRowRadii; //! mean radius of the pad rows holding hits in this event
+  vector<Double_t> fRowRadiusSum;      //!
+  vector<Int_t> fRowNumHits;           //!
+
+  Int_t fHitArrayCapacity = 2000; ///< initial capacity of the working hit arrays, so they do not grow during events
+  Long64_t fNumAllocationsAtEventStart = 0;
+  Long64_t fNumAllocationsInEvent = -1;
 
   Double_t fDefaultScale;
   Double_t fTrackWCutLL; ///< Track width cut low limit
@@ -118,6 +350,11 @@ private:
   KBVector3::Axis fReferenceAxis;
 
   Int_t fPhaseIndex = 0;
+  vector<LHHelixTrackFindingPhase> fPhases; //!
+  vector<Double_t> fPhaseTimes;             //! real time spent in each phase of the current event [s]
+  vector<Int_t> fPhaseNumTracks;            //! number of tracks found in each phase of the current event
+  Int_t fNumTracksBeforePhase = 0;
+  TStopwatch fPhaseStopwatch; //!
 
   Int_t fMinHitsToFitInitTrack = 7;        ///< try track fit if track has more than this number of hits in track
   Int_t fCutMinNumHitsInitTrack = 10;      ///
@@ -128,8 +365,20 @@ private:
   Double_t fCutdkInExpectedTrackPath = 4.; // the correlation distance cut through helix axis during the track path between two hits
 
   KBHelixTrack *fCurrentTrack = nullptr;
+  Int_t fCurrentTrackIndex = -1; ///< index of fCurrentTrack in fTrackArray
 
   Int_t fNextStep = StepNo::kStepInitArray;
+  Int_t fRunningStep = StepNo::kStepInitArray;
+
+  bool fUseStepTiming = false;
+  Long64_t fStepCounts[kStepEndOfEvent] = {};
+  Double_t fStepTimes[kStepEndOfEvent] = {};                   ///< [s]
+  Long64_t fStepNumPulledHits[kStepEndOfEvent] = {};
+  Long64_t fStepTransitions[kStepEndOfEvent][kStepEndOfEvent + 1] = {}; ///< [step][next step]
+  Long64_t fNumRemovedTracks[kNumRemoveReasons] = {};
+
+  TString fStepTraceFileName;
+  LHStepTraceWriter *fStepTrace = nullptr; //!
   Int_t fNumCandHits;
   Int_t fNumGoodHits;
   Int_t fNumBadHits;
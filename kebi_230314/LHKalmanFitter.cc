@@ -0,0 +1,304 @@
+#include "LHKalmanFitter.hh"
+
+#include "TMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const Double_t kB2C = LHKalmanTrack::kB2C;
+
+bool LHKalmanFitter::Fit(KBHelixTrack *track, LHKalmanTrack *result, const vector<KBHit *> *hits_FT)
+{
+  fPoints.clear();
+
+  auto hitArray = track->GetHitArray();
+  Int_t numHits = hitArray->GetNumHits();
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+    AddPoint(hitArray->GetHit(iHit), false);
+
+  Int_t numFTHits = 0;
+  if (hits_FT != nullptr)
+  {
+    for (auto hit : *hits_FT)
+      AddPoint(hit, true);
+    numFTHits = hits_FT->size();
+  }
+
+  Int_t numPoints = fPoints.size();
+  if (numPoints < 3)
+    return false;
+
+  sort(fPoints.begin(), fPoints.end(), [](const Point &a, const Point &b)
+       { return a.fX < b.fX; });
+
+  State state;
+  if (!Seed(track, state))
+    return false;
+
+  // outward pass
+  for (Int_t iPoint = 1; iPoint < numPoints; ++iPoint)
+    if (!Step(state, fPoints[iPoint]))
+      return false;
+
+  // inward pass from the outermost hit
+  ResetCovariance(state);
+  state.fChi2 = 0;
+  state.fNumUpdates = 0;
+  for (Int_t iPoint = numPoints - 1; iPoint >= 0; --iPoint)
+    if (!Step(state, fPoints[iPoint]))
+      return false;
+
+  if (state.fNumUpdates < 3)
+    return false;
+
+  result->Clear();
+  result->SetAlpha(state.fAlpha);
+  result->SetX(state.fX);
+  for (Int_t i = 0; i < 5; ++i)
+  {
+    result->SetParameter(i, state.fP[i]);
+    for (Int_t j = 0; j <= i; ++j)
+      result->SetCovariance(i, j, state.fC(i, j));
+  }
+  result->SetChi2(state.fChi2);
+  result->SetNDF(2 * state.fNumUpdates - 5);
+  result->SetNumFTHits(numFTHits);
+
+  return true;
+}
+
+void LHKalmanFitter::AddPoint(KBHit *hit, bool isFT)
+{
+  KBVector3 qos(hit->GetPosition(), fReferenceAxis);
+
+  Point point;
+  point.fAlpha = atan2(qos.J(), qos.I());
+  point.fX = sqrt(qos.I() * qos.I() + qos.J() * qos.J());
+  point.fK = qos.K();
+  point.fIsFT = isFT;
+  point.fSigmaY = isFT ? fSigmaY_FT : fSigmaY;
+  point.fSigmaK = isFT ? fSigmaK_FT : fSigmaK;
+  fPoints.push_back(point);
+}
+
+bool LHKalmanFitter::Seed(KBHelixTrack *track, State &state) const
+{
+  Double_t radius = track->GetHelixRadius();
+  if (!(radius > 0))
+    return false;
+
+  const Point &first = fPoints.front();
+  const Point &last = fPoints.back();
+
+  // helix center in the frame of the first hit, which sits at (fX, 0)
+  Double_t ca = cos(first.fAlpha), sa = sin(first.fAlpha);
+  Double_t ci = track->GetHelixCenterI(), cj = track->GetHelixCenterJ();
+  Double_t cx = ci * ca + cj * sa;
+  Double_t cy = -ci * sa + cj * ca;
+
+  // outgoing tangent of the circle
+  Double_t rx = first.fX - cx, ry = -cy;
+  Double_t tx = -ry / radius, ty = rx / radius;
+  if (tx < 0)
+  {
+    tx = -tx;
+    ty = -ty;
+  }
+  if (abs(ty) >= fMaxSnp)
+    return false;
+
+  Double_t turn = tx * (cy - 0.) - ty * (cx - first.fX);
+  Double_t curvature = (turn > 0 ? 1. : -1.) / radius;
+
+  // tan(lambda) from the chord length in the pad plane between consecutive hits
+  Double_t length = 0;
+  Int_t numPoints = fPoints.size();
+  for (Int_t iPoint = 1; iPoint < numPoints; ++iPoint)
+  {
+    auto &p0 = fPoints[iPoint - 1];
+    auto &p1 = fPoints[iPoint];
+    Double_t di = p1.fX * cos(p1.fAlpha) - p0.fX * cos(p0.fAlpha);
+    Double_t dj = p1.fX * sin(p1.fAlpha) - p0.fX * sin(p0.fAlpha);
+    length += sqrt(di * di + dj * dj);
+  }
+  if (length <= 0)
+    return false;
+
+  state.fAlpha = first.fAlpha;
+  state.fX = first.fX;
+  state.fP[0] = 0;
+  state.fP[1] = first.fK;
+  state.fP[2] = ty;
+  state.fP[3] = (last.fK - first.fK) / length;
+  state.fP[4] = curvature / (kB2C * fBField);
+
+  state.fC = SymMatrix5();
+  state.fC(0, 0) = first.fSigmaY * first.fSigmaY;
+  state.fC(1, 1) = first.fSigmaK * first.fSigmaK;
+  state.fC(2, 2) = 0.01;
+  state.fC(3, 3) = 0.01;
+  state.fC(4, 4) = pow(0.3 * state.fP[4], 2);
+  state.fChi2 = 0;
+  state.fNumUpdates = 1;
+
+  return true;
+}
+
+bool LHKalmanFitter::Step(State &state, const Point &point) const
+{
+  if (!Rotate(state, point.fAlpha))
+    return false;
+
+  Double_t x0 = state.fX;
+  if (!Propagate(state, point.fX))
+    return false;
+
+  Double_t cosPhi = sqrt((1. - state.fP[2]) * (1. + state.fP[2]));
+  AddScattering(state, abs(point.fX - x0) * sqrt(1. + state.fP[3] * state.fP[3]) / cosPhi);
+
+  if (Update(state, point))
+    ++state.fNumUpdates;
+
+  return true;
+}
+
+bool LHKalmanFitter::Rotate(State &state, Double_t alpha) const
+{
+  Double_t dAlpha = alpha - state.fAlpha;
+  if (dAlpha == 0)
+    return true;
+
+  Double_t ca = cos(dAlpha), sa = sin(dAlpha);
+  Double_t sf = state.fP[2];
+  Double_t cf = sqrt((1. - sf) * (1. + sf));
+  Double_t snp = sf * ca - cf * sa;
+  if (abs(snp) >= fMaxSnp)
+    return false;
+  Double_t csp = sqrt((1. - snp) * (1. + snp));
+
+  // the reference point stays on the track; a shift in y moves it along the track in the new frame
+  Matrix5 jacobian;
+  for (Int_t i = 0; i < 5; ++i)
+    jacobian(i, i) = 1.;
+  jacobian(0, 0) = cf / csp;
+  jacobian(1, 0) = -sa * state.fP[3] / csp;
+  jacobian(2, 2) = csp / cf;
+
+  Double_t x = state.fX, y = state.fP[0];
+  state.fAlpha = alpha;
+  state.fX = x * ca + y * sa;
+  state.fP[0] = -x * sa + y * ca;
+  state.fP[2] = snp;
+  state.fC = ROOT::Math::Similarity(jacobian, state.fC);
+
+  return true;
+}
+
+bool LHKalmanFitter::Propagate(State &state, Double_t x) const
+{
+  Double_t dx = x - state.fX;
+  if (dx == 0)
+    return true;
+
+  Double_t cc = kB2C * fBField;
+  Double_t crv = cc * state.fP[4];
+  Double_t x2r = crv * dx;
+  Double_t f1 = state.fP[2], f2 = f1 + x2r;
+  if (abs(f1) >= fMaxSnp || abs(f2) >= fMaxSnp)
+    return false;
+
+  Double_t r1 = sqrt((1. - f1) * (1. + f1)), r2 = sqrt((1. - f2) * (1. + f2));
+  Double_t dy2dx = (f1 + f2) / (r1 + r2);
+  Double_t tgl = state.fP[3];
+
+  // transport matrix at first order in dx, evaluated before the step
+  Double_t r1cube = r1 * r1 * r1;
+  Matrix5 jacobian;
+  for (Int_t i = 0; i < 5; ++i)
+    jacobian(i, i) = 1.;
+  jacobian(0, 2) = dx / r1cube;
+  jacobian(0, 4) = 0.5 * dx * dx / r1cube * cc;
+  jacobian(1, 2) = dx * tgl * f1 / r1cube;
+  jacobian(1, 3) = dx / r1;
+  jacobian(1, 4) = 0.5 * dx * dx * tgl * f1 / r1cube * cc;
+  jacobian(2, 4) = dx * cc;
+
+  state.fP[0] += dx * dy2dx;
+  if (abs(x2r) < 0.05)
+    state.fP[1] += dx * (r2 + f2 * dy2dx) * tgl;
+  else
+  {
+    Double_t rot = asin(r1 * f2 - r2 * f1);
+    if (f1 * f1 + f2 * f2 > 1 && f1 * f2 < 0)
+      rot = (rot > 0 ? TMath::Pi() : -TMath::Pi()) - rot;
+    state.fP[1] += tgl / crv * rot;
+  }
+  state.fP[2] = f2;
+  state.fX = x;
+  state.fC = ROOT::Math::Similarity(jacobian, state.fC);
+
+  return true;
+}
+
+void LHKalmanFitter::AddScattering(State &state, Double_t path) const
+{
+  if (fRadiationLength <= 0 || state.fP[4] == 0)
+    return;
+
+  Double_t snp = state.fP[2], tgl = state.fP[3], qpt = state.fP[4];
+  Double_t p2 = (1. + tgl * tgl) / (qpt * qpt);
+  Double_t beta2 = p2 / (p2 + fMass * fMass);
+  Double_t theta2 = 0.0136 * 0.0136 / (beta2 * p2) * path / fRadiationLength;
+
+  state.fC(2, 2) += theta2 * (1. - snp * snp) * (1. + tgl * tgl);
+  state.fC(3, 3) += theta2 * (1. + tgl * tgl) * (1. + tgl * tgl);
+  state.fC(4, 3) += theta2 * tgl * qpt * (1. + tgl * tgl);
+  state.fC(4, 4) += theta2 * tgl * tgl * qpt * qpt;
+}
+
+bool LHKalmanFitter::Update(State &state, const Point &point) const
+{
+  auto &c = state.fC;
+
+  Double_t s00 = c(0, 0) + point.fSigmaY * point.fSigmaY;
+  Double_t s01 = c(1, 0);
+  Double_t s11 = c(1, 1) + point.fSigmaK * point.fSigmaK;
+  Double_t det = s00 * s11 - s01 * s01;
+  if (det <= 0)
+    return false;
+
+  Double_t w00 = s11 / det, w01 = -s01 / det, w11 = s00 / det;
+  Double_t r0 = 0. - state.fP[0];
+  Double_t r1 = point.fK - state.fP[1];
+  Double_t chi2 = r0 * r0 * w00 + 2 * r0 * r1 * w01 + r1 * r1 * w11;
+  if (chi2 > fCutChi2)
+    return false;
+
+  // gain K = C H^T S^-1, H selects (y, k)
+  Double_t gain[5][2];
+  for (Int_t i = 0; i < 5; ++i)
+  {
+    gain[i][0] = c(i, 0) * w00 + c(i, 1) * w01;
+    gain[i][1] = c(i, 0) * w01 + c(i, 1) * w11;
+  }
+
+  for (Int_t i = 0; i < 5; ++i)
+    state.fP[i] += gain[i][0] * r0 + gain[i][1] * r1;
+
+  SymMatrix5 updated;
+  for (Int_t i = 0; i < 5; ++i)
+    for (Int_t j = 0; j <= i; ++j)
+      updated(i, j) = c(i, j) - gain[i][0] * c(0, j) - gain[i][1] * c(1, j);
+  state.fC = updated;
+
+  state.fChi2 += chi2;
+  return true;
+}
+
+void LHKalmanFitter::ResetCovariance(State &state) const
+{
+  SymMatrix5 reset;
+  for (Int_t i = 0; i < 5; ++i)
+    reset(i, i) = state.fC(i, i) * fCovarianceResetScale;
+  state.fC = reset;
+}
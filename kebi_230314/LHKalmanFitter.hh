@@ -0,0 +1,96 @@
+#ifndef LHKALMANFITTER_HH
+#define LHKALMANFITTER_HH
+
+#include "Math/SMatrix.h"
+
+#include "KBHelixTrack.hh"
+#include "KBVector3.hh"
+
+#include "LHKalmanTrack.hh"
+
+#include <vector>
+using namespace std;
+
+/**
+ * Kalman refit of KBHelixTrack hits with fixed-size 5x5 matrices.
+ *
+ * The state (see LHKalmanTrack) is propagated in a uniform field along the
+ * drift axis from hit to hit in a frame rotated to the azimuth of each hit,
+ * so every hit measures (y = 0, k) at its radial distance x. Hits are ordered
+ * in x; the pattern-recognition helix gives the seed. An outward pass is
+ * followed by an inward pass started from the outward result with a reset
+ * covariance, so the state at the innermost hit uses all hits. FT hits are
+ * given apart from the TPC hits of the track and enter as measurements with
+ * their own errors. Multiple scattering in the gas is
+ * added as process noise when fRadiationLength > 0.
+ */
+class LHKalmanFitter
+{
+public:
+  typedef ROOT::Math::SVector<Double_t, 5> Vector5;
+  typedef ROOT::Math::SMatrix<Double_t, 5, 5> Matrix5;
+  typedef ROOT::Math::SMatrix<Double_t, 5, 5, ROOT::Math::MatRepSym<Double_t, 5>> SymMatrix5;
+
+  LHKalmanFitter() {}
+  virtual ~LHKalmanFitter() {}
+
+  void SetReferenceAxis(KBVector3::Axis axis) { fReferenceAxis = axis; }
+  void SetBField(Double_t val) { fBField = val; } ///< [T], along the drift axis
+  void SetHitError(Double_t sigmaY, Double_t sigmaK) { fSigmaY = sigmaY; fSigmaK = sigmaK; }
+  void SetHitError_FT(Double_t sigmaY, Double_t sigmaK) { fSigmaY_FT = sigmaY; fSigmaK_FT = sigmaK; }
+  void SetRadiationLength(Double_t val) { fRadiationLength = val; } ///< [mm], 0 : no multiple scattering
+  void SetMass(Double_t val) { fMass = val; }                       ///< [GeV/c^2], mass hypothesis for the scattering angle
+  void SetCutChi2(Double_t val) { fCutChi2 = val; }                 ///< hits with a larger chi2 increment are skipped
+
+  /**
+   * Refit the TPC hits of track together with the FT hits matched to it (hits_FT, see LHFTAssociation).
+   * Returns false if the track has less than three usable hits or leaves the frame (|sin(phi)| > fMaxSnp).
+   */
+  bool Fit(KBHelixTrack *track, LHKalmanTrack *result, const vector<KBHit *> *hits_FT = nullptr);
+
+private:
+  struct State
+  {
+    Double_t fAlpha;
+    Double_t fX;
+    Vector5 fP;
+    SymMatrix5 fC;
+    Double_t fChi2;
+    Int_t fNumUpdates;
+  };
+
+  struct Point
+  {
+    Double_t fAlpha;
+    Double_t fX;
+    Double_t fK;
+    Double_t fSigmaY;
+    Double_t fSigmaK;
+    bool fIsFT;
+  };
+
+  bool Seed(KBHelixTrack *track, State &state) const;
+  bool Rotate(State &state, Double_t alpha) const;
+  bool Propagate(State &state, Double_t x) const;
+  void AddScattering(State &state, Double_t path) const;
+  bool Update(State &state, const Point &point) const;
+  bool Step(State &state, const Point &point) const;
+  void ResetCovariance(State &state) const;
+  void AddPoint(KBHit *hit, bool isFT);
+
+  KBVector3::Axis fReferenceAxis = KBVector3::kZ;
+  Double_t fBField = 0.5;
+  Double_t fSigmaY = 0.5;
+  Double_t fSigmaK = 1.;
+  Double_t fSigmaY_FT = 0.1;
+  Double_t fSigmaK_FT = 0.1;
+  Double_t fRadiationLength = 0.;
+  Double_t fMass = 0.13957;
+  Double_t fCutChi2 = 50.;
+  Double_t fMaxSnp = 0.95;
+  Double_t fCovarianceResetScale = 100.;
+
+  vector<Point> fPoints;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "KBRun.hh"
+#include "LHRunContext.hh"
+#include "KBHelixTrack.hh"
+#include "LHKalmanRefitTask.hh"
+#include "LHFTAssociation.hh"
+
+#include <iostream>
+
+ClassImp(LHKalmanRefitTask)
+
+bool LHKalmanRefitTask::Init()
+{
+  auto run = KBRun::GetRun();
+  fPar = run->GetParameterContainer();
+
+  fTrackArray = (TClonesArray *)LHRunContext::GetBranch(fBranchNameTracklet);
+  if (fTrackArray == nullptr)
+  {
+    kb_error << "No branch " << fBranchNameTracklet << endl;
+    return false;
+  }
+
+  fFTMatchArray = (TClonesArray *)LHRunContext::GetBranch(fBranchNameFTMatch);
+  if (fFTMatchArray != nullptr)
+  {
+    fHitArray_FT = (TClonesArray *)LHRunContext::GetBranch(fBranchNameHit_FT);
+    if (fHitArray_FT == nullptr)
+    {
+      kb_warning << "No branch " << fBranchNameHit_FT << ", refitting without FT hits" << endl;
+      fFTMatchArray = nullptr;
+    }
+  }
+
+  fKalmanTrackArray = new TClonesArray("LHKalmanTrack", 100);
+  LHRunContext::RegisterBranch(fBranchNameKalman, fKalmanTrackArray, fPersistency);
+
+  fFitter.SetReferenceAxis(fPar->GetParAxis("LHTF_refAxis"));
+  fFitter.SetBField(fBField);
+
+  return true;
+}
+
+void LHKalmanRefitTask::Exec(Option_t *)
+{
+  fKalmanTrackArray->Clear("C");
+
+  fStopwatch.Start(kTRUE);
+
+  Int_t numTracks = fTrackArray->GetEntriesFast();
+  Int_t numMatches = fFTMatchArray != nullptr ? fFTMatchArray->GetEntriesFast() : 0;
+  Int_t iMatch = 0;
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    // FT matches are sorted by track
+    fHits_FT.clear();
+    for (; iMatch < numMatches; ++iMatch)
+    {
+      auto association = (LHFTAssociation *)fFTMatchArray->At(iMatch);
+      if (association->GetTrackID() != iTrack)
+        break;
+      fHits_FT.push_back((KBHit *)fHitArray_FT->At(association->GetHitIndex()));
+    }
+
+    auto track = (KBHelixTrack *)fTrackArray->At(iTrack);
+    Int_t idx = fKalmanTrackArray->GetEntriesFast();
+    auto kalmanTrack = (LHKalmanTrack *)fKalmanTrackArray->ConstructedAt(idx, "C");
+    if (fFitter.Fit(track, kalmanTrack, &fHits_FT))
+      kalmanTrack->SetTrackID(iTrack);
+    else
+      fKalmanTrackArray->RemoveAt(idx);
+  }
+
+  fStopwatch.Stop();
+  fRealTime += fStopwatch.RealTime();
+
+  Int_t numFitted = fKalmanTrackArray->GetEntriesFast();
+  fNumFittedTracks += numFitted;
+
+  kb_info << "Kalman refit : " << numFitted << " / " << numTracks << " tracks, " << 1000 * fStopwatch.RealTime() << " ms" << endl;
+}
@@ -0,0 +1,62 @@
+#ifndef LHKALMANREFITTASK_HH
+#define LHKALMANREFITTASK_HH
+
+#include "TClonesArray.h"
+#include "TStopwatch.h"
+
+#include "KBTask.hh"
+
+#include "LHKalmanFitter.hh"
+#include "LHKalmanTrack.hh"
+
+/**
+ * Refits every track of the tracklet branch with LHKalmanFitter and writes
+ * the parameters and covariances at the innermost hit to fBranchNameKalman
+ * (LHKalmanTrack). The FT hits matched to a track are taken from the FT match
+ * branch (LHFTAssociation) when it exists. Tracks which cannot be refitted are
+ * not written; the tracklet index is kept in LHKalmanTrack::GetTrackID.
+ */
+class LHKalmanRefitTask : public KBTask
+{
+public:
+  LHKalmanRefitTask() : KBTask("LHKalmanRefitTask", "LHKalmanRefitTask") {}
+  virtual ~LHKalmanRefitTask() {}
+
+  virtual bool Init();
+  virtual void Exec(Option_t *);
+
+  void SetTrackletBranchName(TString name) { fBranchNameTracklet = name; }
+  void SetKalmanTrackBranchName(TString name) { fBranchNameKalman = name; }
+  void SetHitBranchName_FT(TString name) { fBranchNameHit_FT = name; }
+  void SetFTMatchBranchName(TString name) { fBranchNameFTMatch = name; }
+  void SetPersistency(bool val) { fPersistency = val; }
+  void SetBField(Double_t val) { fBField = val; } ///< [T]
+
+  LHKalmanFitter *GetFitter() { return &fFitter; }
+
+  Double_t GetRealTime() const { return fRealTime; } ///< summed refit time of all events [s]
+  Long64_t GetNumFittedTracks() const { return fNumFittedTracks; }
+
+private:
+  TClonesArray *fTrackArray = nullptr;
+  TClonesArray *fKalmanTrackArray = nullptr;
+  TClonesArray *fHitArray_FT = nullptr;
+  TClonesArray *fFTMatchArray = nullptr;
+
+  TString fBranchNameTracklet = "Tracklet";
+  TString fBranchNameKalman = "KalmanTrack";
+  TString fBranchNameHit_FT = "FTHit";
+  TString fBranchNameFTMatch = "FTMatch";
+  bool fPersistency = true;
+  Double_t fBField = 0.5;
+
+  LHKalmanFitter fFitter; //!
+  vector<KBHit *> fHits_FT; //! of the track being refitted
+  TStopwatch fStopwatch;  //!
+  Double_t fRealTime = 0;
+  Long64_t fNumFittedTracks = 0;
+
+  ClassDef(LHKalmanRefitTask, 1)
+};
+
+#endif
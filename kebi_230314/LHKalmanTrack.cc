@@ -0,0 +1,30 @@
+#include "LHKalmanTrack.hh"
+
+ClassImp(LHKalmanTrack)
+
+void LHKalmanTrack::Clear(Option_t *)
+{
+  fTrackID = -1;
+  fAlpha = 0;
+  fX = 0;
+  for (auto &param : fParam)
+    param = 0;
+  for (auto &cov : fCov)
+    cov = 0;
+  fChi2 = 0;
+  fNDF = 0;
+  fNumFTHits = 0;
+}
+
+TVector3 LHKalmanTrack::PositionIJK() const
+{
+  Double_t ca = cos(fAlpha), sa = sin(fAlpha);
+  return TVector3(fX * ca - fParam[0] * sa, fX * sa + fParam[0] * ca, fParam[1]);
+}
+
+TVector3 LHKalmanTrack::MomentumIJK() const
+{
+  Double_t pt = Pt();
+  Double_t phi = asin(fParam[2]) + fAlpha;
+  return TVector3(pt * cos(phi), pt * sin(phi), pt * fParam[3]);
+}
@@ -0,0 +1,68 @@
+#ifndef LHKALMANTRACK_HH
+#define LHKALMANTRACK_HH
+
+#include "TObject.h"
+#include "TVector3.h"
+
+#include <cmath>
+
+/**
+ * Track parameters of the Kalman refit (LHKalmanFitter) at the innermost hit.
+ *
+ * The parameters are given in a local frame rotated by fAlpha around the
+ * drift axis, at the local coordinate fX [mm] (radial distance of the hit):
+ *   0 : y [mm], 1 : k [mm], 2 : sin(phi), 3 : tan(lambda) = dk/ds_ij, 4 : q/pt [c/GeV]
+ * The covariance is stored as the packed lower triangle (15 values).
+ */
+class LHKalmanTrack : public TObject
+{
+public:
+  LHKalmanTrack() { Clear(); }
+  virtual ~LHKalmanTrack() {}
+
+  virtual void Clear(Option_t *option = "");
+
+  void SetTrackID(Int_t id) { fTrackID = id; }
+  void SetAlpha(Double_t val) { fAlpha = val; }
+  void SetX(Double_t val) { fX = val; }
+  void SetParameter(Int_t i, Double_t val) { fParam[i] = val; }
+  void SetCovariance(Int_t i, Int_t j, Double_t val) { fCov[Index(i, j)] = val; }
+  void SetChi2(Double_t val) { fChi2 = val; }
+  void SetNDF(Int_t val) { fNDF = val; }
+  void SetNumFTHits(Int_t val) { fNumFTHits = val; }
+
+  Int_t GetTrackID() const { return fTrackID; } ///< index of the pattern-recognition track in the Tracklet branch
+  Double_t GetAlpha() const { return fAlpha; }
+  Double_t GetX() const { return fX; }
+  Double_t GetParameter(Int_t i) const { return fParam[i]; }
+  Double_t GetCovariance(Int_t i, Int_t j) const { return fCov[Index(i, j)]; }
+  Double_t GetChi2() const { return fChi2; }
+  Int_t GetNDF() const { return fNDF; }
+  Int_t GetNumFTHits() const { return fNumFTHits; }
+
+  /// curvature [1/mm] = kB2C * B [T] * q/pt [c/GeV]; negative since a positive track in +B bends towards -y
+  static constexpr Double_t kB2C = -0.299792458e-3;
+
+  Double_t Curvature(Double_t bField) const { return kB2C * bField * fParam[4]; }
+  Int_t Charge() const { return fParam[4] > 0 ? 1 : -1; }
+  Double_t Pt() const { return fParam[4] != 0 ? 1. / std::abs(fParam[4]) : 0; }
+  Double_t Momentum() const { return Pt() * std::sqrt(1. + fParam[3] * fParam[3]); }
+  TVector3 PositionIJK() const; ///< (i, j, k) of the reference point
+  TVector3 MomentumIJK() const; ///< (pi, pj, pk) at the reference point [GeV/c]
+
+private:
+  static Int_t Index(Int_t i, Int_t j) { return i >= j ? i * (i + 1) / 2 + j : j * (j + 1) / 2 + i; }
+
+  Int_t fTrackID;
+  Double_t fAlpha;
+  Double_t fX;
+  Double_t fParam[5];
+  Double_t fCov[15];
+  Double_t fChi2;
+  Int_t fNDF;
+  Int_t fNumFTHits;
+
+  ClassDef(LHKalmanTrack, 1)
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "LHParallelEventLoop.hh"
+#include "LHParallelFor.hh"
+
+#include "TROOT.h"
+
+#include <chrono>
+#include <thread>
+
+LHEventWorker::~LHEventWorker()
+{
+  for (auto task : fTasks)
+    delete task;
+}
+
+LHParallelEventLoop::~LHParallelEventLoop()
+{
+  DeleteWorkers();
+}
+
+void LHParallelEventLoop::DeleteWorkers()
+{
+  for (auto worker : fWorkers)
+    delete worker;
+  fWorkers.clear();
+}
+
+bool LHParallelEventLoop::Init()
+{
+  DeleteWorkers();
+
+  if (!fTaskFactory)
+  {
+    kb_error << "No task factory" << endl;
+    return false;
+  }
+
+  if (!fPrefetcher.Open(fInputFileName, fInputTreeName))
+    return false;
+
+  if (fNumWorkers <= 0)
+    fNumWorkers = thread::hardware_concurrency();
+
+  ROOT::EnableThreadSafety();
+
+  auto par = KBRun::GetRun()->GetParameterContainer();
+  for (Int_t iWorker = 0; iWorker < fNumWorkers; ++iWorker)
+  {
+    auto worker = new LHEventWorker(iWorker, par);
+    LHRunContext::SetCurrent(&worker->fContext);
+
+    for (auto &branch : fPrefetcher.GetBranches())
+    {
+      auto array = new TClonesArray(branch.fClassName);
+      LHRunContext::RegisterBranch(branch.fName, array, false);
+      worker->fInputArrays.push_back(array);
+    }
+
+    fTaskFactory(worker);
+
+    bool initialized = true;
+    for (auto task : worker->fTasks)
+      if (!task->Init())
+      {
+        kb_error << "Cannot initialize " << task->GetName() << " of worker " << iWorker << endl;
+        initialized = false;
+        break;
+      }
+
+    for (auto &branch : fWriter.GetBranches())
+    {
+      auto array = (TClonesArray *)LHRunContext::GetBranch(branch.fName);
+      if (array == nullptr)
+      {
+        kb_error << "No output branch " << branch.fName << " in worker " << iWorker << endl;
+        initialized = false;
+      }
+      worker->fOutputArrays.push_back(array);
+    }
+
+    LHRunContext::SetCurrent(nullptr);
+    if (!initialized)
+    {
+      delete worker;
+      DeleteWorkers();
+      return false;
+    }
+
+    fWorkers.push_back(worker);
+  }
+
+  kb_info << "Initialized " << fNumWorkers << " event workers" << endl;
+
+  return true;
+}
+
+void LHParallelEventLoop::Run(Long64_t numEvents)
+{
+  if (fWorkers.empty())
+  {
+    kb_error << "Run Init first" << endl;
+    return;
+  }
+
+  if (numEvents < 0 || numEvents > fPrefetcher.GetEntries())
+    numEvents = fPrefetcher.GetEntries();
+  fNumEvents = numEvents;
+
+  Int_t numSlots = 2 * fNumWorkers;
+  fUseWriter = !fOutputFileName.IsNull() && !fWriter.GetBranches().empty();
+  if (fUseWriter && !fWriter.Open(fOutputFileName, fOutputTreeName, numSlots))
+    return;
+
+  auto start = chrono::steady_clock::now();
+  fNextEvent = 0;
+  fPrefetcher.Start(numEvents, numSlots);
+
+  LHParallelFor(fNumWorkers, fNumWorkers, [this](int iWorker) { RunWorker(fWorkers[iWorker]); });
+
+  fPrefetcher.Stop();
+  if (fUseWriter)
+    fWriter.Close();
+  fRealTime = chrono::duration<Double_t>(chrono::steady_clock::now() - start).count();
+
+  kb_info << "Processed " << numEvents << " events on " << fNumWorkers << " workers in " << fRealTime << " s" << endl;
+  for (auto worker : fWorkers)
+    kb_info << "  worker " << worker->fIndex << " : " << worker->fNumEvents << " events" << endl;
+  kb_info << "  input  : read " << fPrefetcher.GetReadTime() << " s, waited " << fPrefetcher.GetWaitTime() << " s" << endl;
+  if (fUseWriter)
+    kb_info << "  output : fill " << fWriter.GetWriteTime() << " s, waited " << fWriter.GetWaitTime() << " s" << endl;
+}
+
+void LHParallelEventLoop::RunWorker(LHEventWorker *worker)
+{
+  LHRunContext::SetCurrent(&worker->fContext);
+  worker->fNumEvents = 0;
+
+  Long64_t event;
+  while ((event = fNextEvent++) < fNumEvents)
+  {
+    if (!fPrefetcher.Take(event, worker->fInputArrays))
+    {
+      if (fUseWriter)
+        fWriter.Skip(event);
+      continue;
+    }
+
+    LHRunContext::SetEventID(event);
+    for (auto task : worker->fTasks)
+      task->Exec("");
+    ++worker->fNumEvents;
+
+    if (fUseWriter)
+      fWriter.Push(event, worker->fOutputArrays);
+  }
+
+  LHRunContext::SetCurrent(nullptr);
+  LHRunContext::SetEventID(-1);
+}
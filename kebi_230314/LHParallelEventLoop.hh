@@ -0,0 +1,112 @@
+#ifndef LHPARALLELEVENTLOOP_HH
+#define LHPARALLELEVENTLOOP_HH
+
+#include "TClonesArray.h"
+
+#include "KBTask.hh"
+#include "LHRunContext.hh"
+#include "LHAsyncEventLoop.hh"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+using namespace std;
+
+/// Task list of one LHParallelEventLoop worker, with its own branches and LHTpc (LHRunContext)
+class LHEventWorker
+{
+public:
+  LHEventWorker(Int_t index, KBParameterContainer *par) : fIndex(index), fContext(par) {}
+  /// Deletes the tasks; the branch arrays are deleted with the context
+  virtual ~LHEventWorker();
+
+  Int_t GetWorkerIndex() const { return fIndex; }
+  void Add(KBTask *task) { fTasks.push_back(task); }
+
+private:
+  friend class LHParallelEventLoop;
+
+  Int_t fIndex;
+  LHRunContext fContext;
+  vector<KBTask *> fTasks;
+  vector<TClonesArray *> fInputArrays;
+  vector<TClonesArray *> fOutputArrays;
+  Long64_t fNumEvents = 0;
+};
+
+/**
+ * Event-level parallel event loop.
+ *
+ * The task factory is called once per worker and adds a fresh copy of the
+ * task list to it; the copies are initialized through the worker's
+ * LHRunContext, so branch arrays, pad planes and helix fitters are never
+ * shared and workers run without locks (bench_parallel in run.C measures the
+ * scaling). Workers take the next event number from a shared counter, get its
+ * input from one LHEventPrefetcher and push their output branches to one
+ * LHEventWriter, which writes the events in input order independent of the
+ * worker count.
+ *
+ * Only tasks resolving their branches through LHRunContext (the LH tasks of
+ * this directory) can run on workers; drift, electronics and PSA tasks of KEBI
+ * cannot, so the parallel chain starts from LHFastSimTask or from hits.
+ * Random numbers must be seeded per event from LHRunContext::GetEventID
+ * (LHFastSimTask::SetEventSeed), so the output does not depend on which worker
+ * processed an event or on the number of workers.
+ * Call Init after KBRun::Init, which provides the parameters.
+ */
+class LHParallelEventLoop
+{
+public:
+  LHParallelEventLoop() {}
+  virtual ~LHParallelEventLoop();
+
+  void SetNumWorkers(Int_t val) { fNumWorkers = val; }
+  void SetTaskFactory(function<void(LHEventWorker *)> factory) { fTaskFactory = factory; }
+
+  void SetInputFile(TString fileName, TString treeName = "event")
+  {
+    fInputFileName = fileName;
+    fInputTreeName = treeName;
+  }
+  void SetOutputFile(TString fileName, TString treeName = "event")
+  {
+    fOutputFileName = fileName;
+    fOutputTreeName = treeName;
+  }
+
+  template <class T>
+  void AddInputBranch(TString name) { fPrefetcher.AddBranch<T>(name); }
+  template <class T>
+  void AddOutputBranch(TString name) { fWriter.AddBranch<T>(name); }
+
+  bool Init();
+  /// Process numEvents (all input entries if negative)
+  void Run(Long64_t numEvents = -1);
+
+  Double_t GetRealTime() const { return fRealTime; }
+  Long64_t GetNumEvents() const { return fNumEvents; } ///< events of the last Run
+
+private:
+  void RunWorker(LHEventWorker *worker);
+  void DeleteWorkers();
+
+  Int_t fNumWorkers = 0; ///< 0 : use all hardware threads
+  function<void(LHEventWorker *)> fTaskFactory;
+
+  TString fInputFileName;
+  TString fInputTreeName = "event";
+  TString fOutputFileName;
+  TString fOutputTreeName = "event";
+
+  LHEventPrefetcher fPrefetcher;
+  LHEventWriter fWriter;
+  vector<LHEventWorker *> fWorkers;
+
+  atomic<Long64_t> fNextEvent;
+  Long64_t fNumEvents = 0;
+  bool fUseWriter = false;
+
+  Double_t fRealTime = 0;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef LHPARALLELFOR_HH
+#define LHPARALLELFOR_HH
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+
+/**
+ * Run func(i) for i = 0 .. numJobs-1 on up to numThreads worker threads.
+ * Jobs are handed out through an atomic counter, so the caller has to write
+ * results into slot i of a pre-sized container to keep the output order
+ * independent of the scheduling.
+ */
+inline void LHParallelFor(int numJobs, int numThreads, const std::function<void(int)> &func)
+{
+  if (numJobs <= 0)
+    return;
+
+  if (numThreads <= 0)
+    numThreads = std::thread::hardware_concurrency();
+  if (numThreads > numJobs)
+    numThreads = numJobs;
+
+  if (numThreads <= 1)
+  {
+    for (int iJob = 0; iJob < numJobs; ++iJob)
+      func(iJob);
+    return;
+  }
+
+  std::atomic<int> nextJob(0);
+  auto worker = [&]()
+  {
+    int iJob;
+    while ((iJob = nextJob++) < numJobs)
+      func(iJob);
+  };
+
+  std::vector<std::thread> threads;
+  for (int iThread = 1; iThread < numThreads; ++iThread)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "LHRunContext.hh"
+
+thread_local LHRunContext *LHRunContext::fCurrent = nullptr;
+thread_local Long64_t LHRunContext::fEventID = -1;
+
+LHRunContext::LHRunContext(KBParameterContainer *par)
+{
+  fTpc = new LHTpc();
+  fTpc->SetParameterContainer(par);
+  fTpc->Init();
+}
+
+LHRunContext::~LHRunContext()
+{
+  for (auto &branch : fBranches)
+    delete branch.second;
+  delete fTpc;
+}
+
+TObject *LHRunContext::GetBranch(TString name)
+{
+  if (fCurrent == nullptr)
+    return KBRun::GetRun()->GetBranch(name);
+
+  auto found = fCurrent->fBranches.find(name.Data());
+  if (found == fCurrent->fBranches.end())
+    return nullptr;
+  return found->second;
+}
+
+bool LHRunContext::RegisterBranch(TString name, TObject *object, bool persistency)
+{
+  if (fCurrent == nullptr)
+    return KBRun::GetRun()->RegisterBranch(name, object, persistency);
+
+  // worker output is written by LHParallelEventLoop, the persistency flag is not used
+  if (fCurrent->fBranches.find(name.Data()) != fCurrent->fBranches.end())
+  {
+    kb_error << "Branch " << name << " already exists in worker context" << endl;
+    return false;
+  }
+  fCurrent->fBranches[name.Data()] = object;
+  return true;
+}
+
+Long64_t LHRunContext::GetEventID()
+{
+  if (fEventID < 0)
+    return KBRun::GetRun()->GetCurrentEventID();
+  return fEventID;
+}
+
+LHTpc *LHRunContext::GetTpc()
+{
+  if (fCurrent == nullptr)
+    return (LHTpc *)(KBRun::GetRun()->GetDetectorSystem()->GetTpc());
+  return fCurrent->fTpc;
+}
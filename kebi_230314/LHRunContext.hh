@@ -0,0 +1,49 @@
+#ifndef LHRUNCONTEXT_HH
+#define LHRUNCONTEXT_HH
+
+#include "TObject.h"
+#include "TString.h"
+
+#include "KBRun.hh"
+#include "LHTpc.hh"
+
+#include <map>
+#include <string>
+using namespace std;
+
+/**
+ * Branch and detector lookup of the LH tasks.
+ *
+ * Without a current context of the calling thread the static methods forward
+ * to KBRun. LHParallelEventLoop makes the context of a worker current while
+ * the worker initializes and runs its copy of the task list, so every worker
+ * has its own branch arrays and its own LHTpc (and pad plane). The event
+ * loops also set the event number of the calling thread (GetEventID).
+ */
+class LHRunContext
+{
+public:
+  LHRunContext(KBParameterContainer *par);
+  /// Deletes the LHTpc and the branch objects registered in the context
+  virtual ~LHRunContext();
+
+  static TObject *GetBranch(TString name);
+  static bool RegisterBranch(TString name, TObject *object, bool persistency);
+  static LHTpc *GetTpc();
+
+  /// Event processed by the calling thread, KBRun::GetCurrentEventID unless set by an LH event loop
+  static Long64_t GetEventID();
+  static void SetEventID(Long64_t eventID) { fEventID = eventID; }
+
+  static LHRunContext *GetCurrent() { return fCurrent; }
+  static void SetCurrent(LHRunContext *context) { fCurrent = context; }
+
+private:
+  map<string, TObject *> fBranches;
+  LHTpc *fTpc = nullptr;
+
+  static thread_local LHRunContext *fCurrent;
+  static thread_local Long64_t fEventID; ///< -1 : not set
+};
+
+#endif
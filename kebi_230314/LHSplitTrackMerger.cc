@@ -0,0 +1,154 @@
+#include "LHSplitTrackMerger.hh"
+
+#include "TMath.h"
+#include "TVector2.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LHSplitTrackMerger::FindGroups(TClonesArray *trackArray, vector<vector<Int_t>> &groups)
+{
+  groups.clear();
+
+  Int_t numTracks = trackArray->GetEntriesFast();
+  fParameters.resize(numTracks);
+  fParent.resize(numTracks);
+  // keep the cell vectors between events unless stale cells pile up
+  if (fGrid.size() > 16 * UInt_t(numTracks) + 1024)
+    fGrid.clear();
+  for (auto &cell : fGrid)
+    cell.second.clear();
+
+  fNumPhiCells = max(1, Int_t(TMath::TwoPi() / fCutPhi));
+  Double_t phiCellWidth = TMath::TwoPi() / fNumPhiCells;
+
+  auto findParent = [this](Int_t i)
+  {
+    while (fParent[i] != i)
+      i = fParent[i] = fParent[fParent[i]];
+    return i;
+  };
+
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    fParent[iTrack] = iTrack;
+
+    auto &parameters = fParameters[iTrack];
+    if (!ComputeParameters((KBHelixTrack *)trackArray->At(iTrack), parameters))
+      continue;
+
+    parameters.fCell[0] = Int_t(floor(parameters.fCurvature / fCutCurvature));
+    parameters.fCell[1] = Int_t((parameters.fPhi + TMath::Pi()) / phiCellWidth) % fNumPhiCells;
+    parameters.fCell[2] = Int_t(floor(parameters.fTanDip / fCutTanDip));
+    parameters.fCell[3] = Int_t(floor(parameters.fZ0 / fCutZ0));
+
+    // compare with the tracks already in the 81 neighbouring cells
+    Int_t cell[4];
+    for (Int_t d0 = -1; d0 <= 1; ++d0)
+      for (Int_t d1 = -1; d1 <= 1; ++d1)
+        for (Int_t d2 = -1; d2 <= 1; ++d2)
+          for (Int_t d3 = -1; d3 <= 1; ++d3)
+          {
+            cell[0] = parameters.fCell[0] + d0;
+            cell[1] = (parameters.fCell[1] + d1 + fNumPhiCells) % fNumPhiCells;
+            cell[2] = parameters.fCell[2] + d2;
+            cell[3] = parameters.fCell[3] + d3;
+            if (fNumPhiCells < 3 && d1 != 0)
+              continue;
+
+            auto found = fGrid.find(CellKey(cell));
+            if (found == fGrid.end())
+              continue;
+
+            for (auto jTrack : found->second)
+            {
+              if (!IsCompatible(parameters, fParameters[jTrack]))
+                continue;
+              auto iParent = findParent(iTrack);
+              auto jParent = findParent(jTrack);
+              if (iParent < jParent)
+                fParent[jParent] = iParent;
+              else
+                fParent[iParent] = jParent;
+            }
+          }
+
+    fGrid[CellKey(parameters.fCell)].push_back(iTrack);
+  }
+
+  vector<Int_t> groupIndex(numTracks, -1);
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    auto parent = findParent(iTrack);
+    if (parent == iTrack)
+      continue;
+    if (groupIndex[parent] < 0)
+    {
+      groupIndex[parent] = groups.size();
+      groups.push_back({parent});
+    }
+    groups[groupIndex[parent]].push_back(iTrack);
+  }
+}
+
+bool LHSplitTrackMerger::ComputeParameters(KBHelixTrack *track, TrackParameters &parameters) const
+{
+  if (track == nullptr || !track->IsHelix())
+    return false;
+
+  auto hitArray = track->GetHitArray();
+  Int_t numHits = hitArray->GetNumHits();
+  if (numHits < fMinNumHits)
+    return false;
+
+  Double_t ci = track->GetHelixCenterI();
+  Double_t cj = track->GetHelixCenterJ();
+  Double_t radius = track->GetHelixRadius();
+  if (!(radius > 0))
+    return false;
+
+  // k = z0 + slope * (alpha - alphaDCA), alpha measured around the helix center
+  Double_t alphaDCA = atan2(-cj, -ci);
+  Double_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (Int_t iHit = 0; iHit < numHits; ++iHit)
+  {
+    KBVector3 qos(hitArray->GetHit(iHit)->GetPosition(), fReferenceAxis);
+    Double_t x = TVector2::Phi_mpi_pi(atan2(qos.J() - cj, qos.I() - ci) - alphaDCA);
+    sx += x;
+    sy += qos.K();
+    sxx += x * x;
+    sxy += x * qos.K();
+  }
+  Double_t det = numHits * sxx - sx * sx;
+  if (det <= 0)
+    return false;
+
+  Double_t slope = (numHits * sxy - sx * sy) / det;
+  parameters.fZ0 = (sy * sxx - sx * sxy) / det;
+  parameters.fTanDip = slope / radius;
+  parameters.fCurvature = 1. / radius;
+  parameters.fPhi = atan2(cj, ci);
+
+  return true;
+}
+
+bool LHSplitTrackMerger::IsCompatible(const TrackParameters &parameters1, const TrackParameters &parameters2) const
+{
+  if (abs(parameters1.fCurvature - parameters2.fCurvature) > fCutCurvature)
+    return false;
+  if (abs(TVector2::Phi_mpi_pi(parameters1.fPhi - parameters2.fPhi)) > fCutPhi)
+    return false;
+  if (abs(parameters1.fTanDip - parameters2.fTanDip) > fCutTanDip)
+    return false;
+  if (abs(parameters1.fZ0 - parameters2.fZ0) > fCutZ0)
+    return false;
+  return true;
+}
+
+ULong64_t LHSplitTrackMerger::CellKey(const Int_t *cell) const
+{
+  ULong64_t key = 0;
+  for (Int_t i = 0; i < 4; ++i)
+    key = (key << 16) | (ULong64_t(cell[i]) & 0xffff);
+  return key;
+}
@@ -0,0 +1,67 @@
+#ifndef LHSPLITTRACKMERGER_HH
+#define LHSPLITTRACKMERGER_HH
+
+#include "TClonesArray.h"
+
+#include "KBHelixTrack.hh"
+#include "KBVector3.hh"
+
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+/**
+ * Merging stage for tracks split by the phase logic or by gaps.
+ *
+ * Every track is described by curvature 1/R, the azimuth of its helix center
+ * (phi0 up to the charge-dependent pi/2), dip tan(lambda) = dk/ds and z0, the
+ * k coordinate at the point of closest approach to the beam axis, the last two
+ * from a straight line fit of k against the helix angle of its hits. Tracks are
+ * put into a hash grid with the cuts as cell widths, so compatible pairs are
+ * only searched in the 3^4 neighbouring cells; the pairs passing all four cuts
+ * are joined transitively.
+ */
+class LHSplitTrackMerger
+{
+public:
+  LHSplitTrackMerger() {}
+  virtual ~LHSplitTrackMerger() {}
+
+  void SetReferenceAxis(KBVector3::Axis axis) { fReferenceAxis = axis; }
+  void SetCutCurvature(Double_t val) { fCutCurvature = val; }
+  void SetCutPhi(Double_t val) { fCutPhi = val; }
+  void SetCutTanDip(Double_t val) { fCutTanDip = val; }
+  void SetCutZ0(Double_t val) { fCutZ0 = val; }
+  void SetMinNumHits(Int_t val) { fMinNumHits = val; }
+
+  /// Fill groups of track indices (KBHelixTrack of trackArray) to be merged, each group with at least two tracks, sorted by first index
+  void FindGroups(TClonesArray *trackArray, vector<vector<Int_t>> &groups);
+
+private:
+  struct TrackParameters
+  {
+    Double_t fCurvature = 0;
+    Double_t fPhi = 0;
+    Double_t fTanDip = 0;
+    Double_t fZ0 = 0;
+    Int_t fCell[4];
+  };
+
+  bool ComputeParameters(KBHelixTrack *track, TrackParameters &parameters) const;
+  bool IsCompatible(const TrackParameters &parameters1, const TrackParameters &parameters2) const;
+  ULong64_t CellKey(const Int_t *cell) const;
+
+  KBVector3::Axis fReferenceAxis = KBVector3::kZ;
+  Double_t fCutCurvature = 1.e-4; ///< [1/mm]
+  Double_t fCutPhi = 0.05;        ///< helix center azimuth [rad]
+  Double_t fCutTanDip = 0.05;
+  Double_t fCutZ0 = 20.;          ///< [mm]
+  Int_t fMinNumHits = 5;          ///< tracks with fewer hits are not merged
+
+  Int_t fNumPhiCells = 1;
+  vector<TrackParameters> fParameters;
+  vector<Int_t> fParent;
+  unordered_map<ULong64_t, vector<Int_t>> fGrid;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "KBRun.hh"
+#include "LHStepTrace.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static const char kTraceMagic[4] = {'L', 'H', 'S', 'T'};
+static const Int_t kTraceVersion = 1;
+
+static const char *kTraceTypeNames[] = {"event", "end", "step", "hit+", "hit-", "removed", "finalized"};
+
+bool LHStepTraceWriter::Open(TString fileName)
+{
+  Close();
+
+  fFile.open(fileName.Data(), std::ios::binary | std::ios::trunc);
+  if (!fFile.is_open())
+    return false;
+
+  fFile.write(kTraceMagic, 4);
+  fFile.write((const char *)&kTraceVersion, sizeof(kTraceVersion));
+  fBuffer.reserve(fBufferSize);
+
+  return true;
+}
+
+void LHStepTraceWriter::Flush()
+{
+  if (fFile.is_open() && !fBuffer.empty())
+    fFile.write((const char *)fBuffer.data(), fBuffer.size() * sizeof(LHStepTraceRecord));
+  fBuffer.clear();
+  if (fFile.is_open())
+    fFile.flush();
+}
+
+void LHStepTraceWriter::Close()
+{
+  if (!fFile.is_open())
+    return;
+
+  Flush();
+  fFile.close();
+}
+
+bool LHStepTraceReader::Open(TString fileName)
+{
+  fFile.open(fileName.Data(), std::ios::binary);
+  if (!fFile.is_open())
+    return false;
+
+  char magic[4];
+  Int_t version = 0;
+  fFile.read(magic, 4);
+  fFile.read((char *)&version, sizeof(version));
+  if (!fFile || memcmp(magic, kTraceMagic, 4) != 0 || version != kTraceVersion)
+  {
+    kb_error << fileName << " is not a step trace of version " << kTraceVersion << endl;
+    fFile.close();
+    return false;
+  }
+
+  return true;
+}
+
+bool LHStepTraceReader::NextEvent()
+{
+  fRecords.clear();
+  fEventID = -1;
+
+  LHStepTraceRecord record;
+  while (fFile.read((char *)&record, sizeof(record)))
+  {
+    if (record.fType == LHStepTraceRecord::kTraceEventBegin)
+    {
+      fRecords.clear();
+      fEventID = record.fValue;
+    }
+    fRecords.push_back(record);
+    if (record.fType == LHStepTraceRecord::kTraceEventEnd)
+      return true;
+  }
+
+  // an event cut off at the end of the file is still returned, records without an event begin are not
+  return !fRecords.empty() && fRecords.front().fType == LHStepTraceRecord::kTraceEventBegin;
+}
+
+void LHStepTraceReader::CountSteps(vector<Long64_t> &counts, vector<vector<Long64_t>> &transitions) const
+{
+  for (auto &record : fRecords)
+  {
+    if (record.fType != LHStepTraceRecord::kTraceStep)
+      continue;
+
+    Int_t size = max(record.fStep, record.fNextStep) + 1;
+    if (Int_t(counts.size()) < size)
+      counts.resize(size, 0);
+    if (Int_t(transitions.size()) < size)
+      transitions.resize(size);
+    for (auto &row : transitions)
+      if (Int_t(row.size()) < size)
+        row.resize(size, 0);
+
+    ++counts[record.fStep];
+    ++transitions[record.fStep][record.fNextStep];
+  }
+}
+
+void LHStepTraceReader::Print() const
+{
+  Long64_t index = 0;
+  for (auto &record : fRecords)
+  {
+    std::cout << index++ << "\t" << kTraceTypeNames[record.fType]
+              << "\tphase " << Int_t(record.fPhase)
+              << "\tstep " << Int_t(record.fStep) << " -> " << Int_t(record.fNextStep)
+              << "\ttrack " << record.fTrackID
+              << "\tvalue " << record.fValue << std::endl;
+  }
+}
+
+Long64_t LHStepTraceReader::FindFirstDifference(const LHStepTraceReader &reader1, const LHStepTraceReader &reader2)
+{
+  auto &records1 = reader1.fRecords;
+  auto &records2 = reader2.fRecords;
+  Long64_t numCommon = min(records1.size(), records2.size());
+  for (Long64_t index = 0; index < numCommon; ++index)
+    if (records1[index] != records2[index])
+      return index;
+
+  if (records1.size() != records2.size())
+    return numCommon;
+
+  return -1;
+}
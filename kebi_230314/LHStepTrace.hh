@@ -0,0 +1,113 @@
+#ifndef LHSTEPTRACE_HH
+#define LHSTEPTRACE_HH
+
+#include "Rtypes.h"
+#include "TString.h"
+
+#include <fstream>
+#include <vector>
+using namespace std;
+
+/**
+ * Binary trace of the LHHelixTrackFindingTask step machine.
+ *
+ * The trace file starts with the 4-byte magic "LHST" and a 4-byte version,
+ * followed by fixed-size records. Every event is framed by kTraceEventBegin
+ * (value : event ID) and kTraceEventEnd (value : number of tracks after split
+ * merging and FT matching), which follows the record of the last step and
+ * flushes the buffer. Records are written through a buffer, so recording
+ * costs one copy per record.
+ */
+struct LHStepTraceRecord
+{
+  enum Type : UChar_t
+  {
+    kTraceEventBegin,
+    kTraceEventEnd,
+    kTraceStep,         ///< step -> next step of the current track
+    kTraceHitAdded,     ///< value : hit ID added to the track
+    kTraceHitRemoved,   ///< value : hit ID removed from the track
+    kTraceTrackRemoved, ///< step : LHHelixTrackFindingTask::RemoveReason
+    kTraceTrackFinalized, ///< value : number of hits
+  };
+
+  UChar_t fType = 0;
+  UChar_t fStep = 0;
+  UChar_t fNextStep = 0;
+  UChar_t fPhase = 0;
+  Int_t fTrackID = -1;
+  Int_t fValue = 0;
+
+  bool operator==(const LHStepTraceRecord &other) const
+  {
+    return fType == other.fType && fStep == other.fStep && fNextStep == other.fNextStep && fPhase == other.fPhase && fTrackID == other.fTrackID && fValue == other.fValue;
+  }
+  bool operator!=(const LHStepTraceRecord &other) const { return !(*this == other); }
+};
+
+class LHStepTraceWriter
+{
+public:
+  LHStepTraceWriter() {}
+  virtual ~LHStepTraceWriter() { Close(); }
+
+  bool Open(TString fileName);
+  void Close();
+  bool IsOpen() const { return fFile.is_open(); }
+
+  void Add(UChar_t type, UChar_t step, UChar_t nextStep, UChar_t phase, Int_t trackID, Int_t value)
+  {
+    fBuffer.emplace_back();
+    auto &record = fBuffer.back();
+    record.fType = type;
+    record.fStep = step;
+    record.fNextStep = nextStep;
+    record.fPhase = phase;
+    record.fTrackID = trackID;
+    record.fValue = value;
+    if (fBuffer.size() >= fBufferSize)
+      Flush();
+  }
+
+  void Flush();
+
+private:
+  std::ofstream fFile;
+  vector<LHStepTraceRecord> fBuffer;
+  size_t fBufferSize = 1 << 16;
+};
+
+/**
+ * Replays a step trace event by event. The records of one event can be
+ * summarized (step counts, transitions, removal reasons, per-track history)
+ * or compared with the same event of another trace for regression diffs.
+ */
+class LHStepTraceReader
+{
+public:
+  LHStepTraceReader() {}
+  virtual ~LHStepTraceReader() {}
+
+  bool Open(TString fileName);
+
+  /// Read the records of the next event; false at the end of the file
+  bool NextEvent();
+
+  Long64_t GetEventID() const { return fEventID; }
+  const vector<LHStepTraceRecord> &GetRecords() const { return fRecords; }
+
+  /// Add the step executions and transitions of the current event to counts[step] and transitions[step][next]
+  void CountSteps(vector<Long64_t> &counts, vector<vector<Long64_t>> &transitions) const;
+  /// Print the decision sequence of the current event, one line per record
+  void Print() const;
+
+  /// Index of the first record where the current events of the two readers differ, -1 if they are identical
+  static Long64_t FindFirstDifference(const LHStepTraceReader &reader1, const LHStepTraceReader &reader2);
+
+private:
+  std::ifstream fFile;
+  Long64_t fEventID = -1;
+  vector<LHStepTraceRecord> fRecords;
+};
+
+#endif
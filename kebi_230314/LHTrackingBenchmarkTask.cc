@@ -0,0 +1,81 @@
+#include "KBRun.hh"
+#include "LHRunContext.hh"
+#include "LHTrackingBenchmarkTask.hh"
+
+#include <iostream>
+
+ClassImp(LHTrackingBenchmarkTask)
+
+bool LHTrackingBenchmarkTask::Init()
+{
+  fTrackArray = (TClonesArray *)LHRunContext::GetBranch(fBranchNameTracklet);
+
+  if (fGenerator == nullptr)
+  {
+    kb_error << "Generator is not set" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+void LHTrackingBenchmarkTask::ResetCounters()
+{
+  fNumEvents = 0;
+  fNumHits = 0;
+  fNumReconstructable = 0;
+  fNumMatched = 0;
+  fNumFound = 0;
+  fNumFakes = 0;
+  fNumClones = 0;
+}
+
+void LHTrackingBenchmarkTask::Exec(Option_t *)
+{
+  Int_t numMCTracks = fGenerator->GetNumTracks();
+  fMCMatched.assign(numMCTracks, 0);
+  fMCHitCount.assign(numMCTracks, 0);
+
+  ++fNumEvents;
+  fNumHits += fGenerator->GetNumGeneratedHits();
+  for (Int_t mcTrackID = 0; mcTrackID < numMCTracks; ++mcTrackID)
+  {
+    if (fGenerator->GetMCNumHits(mcTrackID) >= fMinReconstructableHits)
+      ++fNumReconstructable;
+  }
+
+  Int_t numTracks = fTrackArray->GetEntriesFast();
+  for (Int_t iTrack = 0; iTrack < numTracks; ++iTrack)
+  {
+    auto track = (KBHelixTrack *)fTrackArray->At(iTrack);
+    if (track == nullptr)
+      continue;
+    ++fNumFound;
+
+    fMCHitCount.assign(numMCTracks, 0);
+    auto trackHits = track->GetHitArray();
+    Int_t numTrackHits = trackHits->GetNumHits();
+    for (Int_t iHit = 0; iHit < numTrackHits; ++iHit)
+    {
+      auto mcTrackID = fGenerator->GetMCTrackID(trackHits->GetHit(iHit)->GetHitID());
+      if (mcTrackID >= 0)
+        fMCHitCount[mcTrackID]++;
+    }
+
+    Int_t bestMC = -1;
+    for (Int_t mcTrackID = 0; mcTrackID < numMCTracks; ++mcTrackID)
+      if (bestMC < 0 || fMCHitCount[mcTrackID] > fMCHitCount[bestMC])
+        bestMC = mcTrackID;
+
+    if (bestMC < 0 || numTrackHits == 0 || fMCHitCount[bestMC] < fMinPurity * numTrackHits)
+    {
+      ++fNumFakes;
+      continue;
+    }
+
+    if (fMCMatched[bestMC]++ > 0)
+      ++fNumClones;
+    else if (fGenerator->GetMCNumHits(bestMC) >= fMinReconstructableHits)
+      ++fNumMatched;
+  }
+}
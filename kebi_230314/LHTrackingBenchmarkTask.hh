@@ -0,0 +1,67 @@
+#ifndef LHTRACKINGBENCHMARKTASK_HH
+#define LHTRACKINGBENCHMARKTASK_HH
+
+#include "TClonesArray.h"
+
+#include "KBTask.hh"
+#include "KBHelixTrack.hh"
+
+#include "LHHelixEventGeneratorTask.hh"
+
+#include <vector>
+using namespace std;
+
+/**
+ * Tracking quality of LHHelixTrackFindingTask on LHHelixEventGeneratorTask events.
+ *
+ * A found track is matched to the MC track owning most of its hits. It is a
+ * fake if that fraction is below fMinPurity, and a clone if the MC track was
+ * already matched by another track. Efficiency is counted over MC tracks with
+ * at least fMinReconstructableHits TPC hits. Counters accumulate over events
+ * until ResetCounters().
+ */
+class LHTrackingBenchmarkTask : public KBTask
+{
+public:
+  LHTrackingBenchmarkTask() : KBTask("LHTrackingBenchmarkTask", "LHTrackingBenchmarkTask") {}
+  virtual ~LHTrackingBenchmarkTask() {}
+
+  virtual bool Init();
+  virtual void Exec(Option_t *);
+
+  void SetGenerator(LHHelixEventGeneratorTask *generator) { fGenerator = generator; }
+  void SetTrackletBranchName(TString name) { fBranchNameTracklet = name; }
+  void SetMinPurity(Double_t val) { fMinPurity = val; }
+  void SetMinReconstructableHits(Int_t val) { fMinReconstructableHits = val; }
+
+  void ResetCounters();
+
+  Long64_t GetNumEvents() const { return fNumEvents; }
+  Long64_t GetNumHits() const { return fNumHits; }
+  Double_t GetEfficiency() const { return (fNumReconstructable > 0 ? Double_t(fNumMatched) / fNumReconstructable : 0); }
+  Double_t GetFakeRate() const { return (fNumFound > 0 ? Double_t(fNumFakes) / fNumFound : 0); }
+  Double_t GetCloneRate() const { return (fNumFound > 0 ? Double_t(fNumClones) / fNumFound : 0); }
+
+private:
+  LHHelixEventGeneratorTask *fGenerator = nullptr;
+  TClonesArray *fTrackArray = nullptr;
+  TString fBranchNameTracklet = "Tracklet";
+
+  Double_t fMinPurity = 0.7;
+  Int_t fMinReconstructableHits = 15;
+
+  Long64_t fNumEvents = 0;
+  Long64_t fNumHits = 0;
+  Long64_t fNumReconstructable = 0;
+  Long64_t fNumMatched = 0;
+  Long64_t fNumFound = 0;
+  Long64_t fNumFakes = 0;
+  Long64_t fNumClones = 0;
+
+  vector<Int_t> fMCMatched;  //!
+  vector<Int_t> fMCHitCount; //!
+
+  ClassDef(LHTrackingBenchmarkTask, 1)
+};
+
+#endif
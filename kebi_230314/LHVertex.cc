@@ -0,0 +1,12 @@
+#include "LHVertex.hh"
+
+ClassImp(LHVertex)
+
+void LHVertex::Clear(Option_t *)
+{
+  fPosition = TVector3(0, 0, 0);
+  fPositionError = TVector3(0, 0, 0);
+  fChi2 = 0;
+  fSumOfWeights = 0;
+  fTrackIDs.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef LHVERTEX_HH
+#define LHVERTEX_HH
+
+#include "TObject.h"
+#include "TVector3.h"
+
+#include <vector>
+
+/// Primary vertex candidate of LHFastVertexFindingTask, position in (i, j, k) of the LHTF_refAxis frame
+class LHVertex : public TObject
+{
+public:
+  LHVertex() { Clear(); }
+  virtual ~LHVertex() {}
+
+  virtual void Clear(Option_t *option = "");
+
+  void SetPosition(TVector3 position) { fPosition = position; }
+  void SetPositionError(TVector3 error) { fPositionError = error; }
+  void SetChi2(Double_t val) { fChi2 = val; }
+  void SetSumOfWeights(Double_t val) { fSumOfWeights = val; }
+  void AddTrack(Int_t trackID) { fTrackIDs.push_back(trackID); }
+
+  TVector3 GetPosition() const { return fPosition; }
+  TVector3 GetPositionError() const { return fPositionError; }
+  Double_t GetChi2() const { return fChi2; }
+  Double_t GetSumOfWeights() const { return fSumOfWeights; } ///< sum of the adaptive track weights
+  Int_t GetNumTracks() const { return fTrackIDs.size(); }     ///< tracks with a final weight above 0.5
+  Int_t GetTrackID(Int_t i) const { return fTrackIDs[i]; }
+
+private:
+  TVector3 fPosition;
+  TVector3 fPositionError;
+  Double_t fChi2;
+  Double_t fSumOfWeights;
+  std::vector<Int_t> fTrackIDs;
+
+  ClassDef(LHVertex, 1)
+};
+
+#endif
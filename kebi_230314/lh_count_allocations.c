@@ -0,0 +1,67 @@
+/*
+ * Heap allocation counter of the allocation benchmarks, preloaded into the
+ * benchmark process so the ROOT libraries keep the allocator of the C library:
+ *
+ *   gcc -shared -fPIC -O2 -o liblh_count_allocations.so lh_count_allocations.c
+ *   LD_PRELOAD=./liblh_count_allocations.so root -b -q bench_tracking.C
+ *
+ * Every allocating entry of malloc is counted, so plain, nothrow and aligned
+ * operator new are all included. LHAllocationCounter finds
+ * lh_num_heap_allocations at load time.
+ */
+
+#include <stddef.h>
+#include <errno.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static long long gNumAllocations = 0;
+
+static void count() { __atomic_fetch_add(&gNumAllocations, 1, __ATOMIC_RELAXED); }
+
+long long lh_num_heap_allocations() { return __atomic_load_n(&gNumAllocations, __ATOMIC_RELAXED); }
+
+void *malloc(size_t size)
+{
+  count();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+  count();
+  return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  count();
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+  count();
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+  count();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  count();
+  void *p = __libc_memalign(alignment, size);
+  if (p == NULL && size != 0)
+    return ENOMEM;
+  *ptr = p;
+  return 0;
+}